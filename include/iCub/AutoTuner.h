@@ -0,0 +1,97 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __AUTOTUNER__
+#define __AUTOTUNER__
+
+// std
+#include <string>
+#include <vector>
+
+// iCub
+#include <iCub/ICalibTool.h>
+
+/**
+ * Startup micro-benchmark selecting the fastest pipeline variant of a
+ * calibration tool on this host.\n
+ * Candidates are the processing backend, demosaicing algorithm, precomposed
+ * output resize and the number of OpenCV worker threads. Results are cached in a per-host
+ * tuning file keyed by frame and output size, OpenCV version and build, and calibration.\n
+ * Map format and CPU tile size are not candidates: CUDA remaps from floating
+ * point maps only, the CPU tiles always use fixed point maps, and their edge is
+ * derived from the L2 cache size (see TiledRemap), which a benchmark on
+ * synthetic frames would not improve on.
+ */
+class AutoTuner
+{
+public:
+
+    struct Variant {
+        int    backend;
+        int    demosaic;
+        bool   precompose;
+        int    threads;
+        double seconds;
+    };
+
+private:
+
+    ICalibTool  *_tool;
+    int         _width;
+    int         _height;
+    int         _outWidth;
+    int         _outHeight;
+    int         _frames;
+    std::string _quality;
+    std::string _calibration;
+    std::vector<int> _backends;
+    int         _fixedDemosaic;     ///< -1 = tuned
+    int         _fixedPrecompose;
+    int         _fixedThreads;
+    Variant     _best;
+
+    double measure(const Variant &v);
+
+public:
+
+    AutoTuner(ICalibTool *tool, int width, int height, int outWidth, int outHeight);
+
+    /** Number of timed frames per candidate */
+    void setFrames(int n) { _frames = n > 0 ? n : 1; }
+    /**
+     * "high" keeps MHT demosaicing and full resolution remap, and only tries
+     * CUDA (the one backend implementing MHT) when it is available; "fast"
+     * allows all variants
+     */
+    void setQuality(const std::string &q) { _quality = q; }
+    /** Backends to try, all available ones by default */
+    void setBackends(const std::vector<int> &backends) { _backends = backends; }
+    /** Keep an explicitly configured value instead of tuning it, like setBackends() */
+    void fixDemosaic(int mode) { _fixedDemosaic = mode; }
+    void fixPrecompose(bool on) { _fixedPrecompose = on ? 1 : 0; }
+    void fixThreads(int n) { _fixedThreads = n; }
+    /** Calibration the result is recorded for, a change invalidates it */
+    void setCalibration(const std::string &config);
+
+    /** Load a previous result, false if missing or recorded for another setup */
+    bool load(const std::string &file);
+    bool save(const std::string &file);
+
+    /** Benchmark all candidates and keep the fastest */
+    void run();
+
+    /** Configure the tool and OpenCV with the selected variant */
+    void apply();
+
+    const Variant &best() const { return _best; }
+
+    /** dir/camCalibTune_<hostname>.ini, in the working directory if dir is empty */
+    static std::string defaultFile(const std::string &dir);
+};
+
+
+#endif
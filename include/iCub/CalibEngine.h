@@ -0,0 +1,144 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __CALIBENGINE__
+#define __CALIBENGINE__
+
+// std
+#include <vector>
+
+// opencv
+#include <opencv2/opencv.hpp>
+
+// iCub
+#include <iCub/ImageView.h>
+#include <iCub/CalibParams.h>
+#include <iCub/IStageTracer.h>
+#include <iCub/ColorLut.h>
+#include <iCub/OutputConverter.h>
+#include <iCub/ProcessingBackend.h>
+
+/**
+ * YARP independent processing engine: demosaicing, undistortion, output
+ * resize, sharpening and color processing of raw camera frames.\n
+ * Works on caller owned strided images (ImageView) and a plain parameter
+ * struct (CalibParams), so it can be linked into other processes from the
+ * camcalib_core library. Maps and buffers are (re)built lazily on the first
+ * frame after the input size or a geometry parameter changed. The image
+ * stages run on a ProcessingBackend chosen at runtime (CalibParams::backend).
+ */
+class CalibEngine
+{
+private:
+
+    CalibParams     _params;
+
+    cv::Mat         _intrinsic;
+    cv::Mat         _intrinsicScaled;
+    cv::Mat         _distortion;
+
+    cv::Mat         _mapUndistortX;
+    cv::Mat         _mapUndistortY;
+
+    ProcessingBackend *_backend;
+
+    bool            _needInit;
+    bool            _mapsPrecomposed;
+    cv::Size        _oldImgSize;
+
+    ColorLut        _colorLut;
+    IStageTracer    *_tracer;
+
+    /** Host copy of the processed frame when no output is RGB */
+    cv::Mat         _hostRgb;
+    /** Blurred copy for sharpening on the host after the color LUT */
+    cv::Mat         _sharpenBlur;
+
+    /** Region of interest with its own backend holding the shifted sub-maps */
+    struct RoiSlot {
+        int                 id;
+        cv::Rect            rect;       ///< requested, undistorted coordinates
+        cv::Rect            dst;        ///< rect moved inside the image
+        cv::Rect            src;        ///< raw window the sub-maps read from
+        bool                dirty;
+        ProcessingBackend   *backend;
+    };
+    std::vector<RoiSlot>    _rois;
+
+    bool init(cv::Size currImgSize);
+    void drawCenterCross(cv::Mat &img);
+    /** False if color processing is left to the host LUT */
+    bool colorOnDevice(ProcessingBackend *backend);
+    void sharpenHost(cv::Mat &img);
+    RoiSlot *findRoi(int id);
+    void prepareRoi(RoiSlot &slot, cv::Size inSize);
+
+    // owns the backend
+    CalibEngine(const CalibEngine &);
+    CalibEngine &operator=(const CalibEngine &);
+
+public:
+
+    CalibEngine();
+    ~CalibEngine();
+
+    /** Replace all parameters */
+    void setParams(const CalibParams &params);
+    const CalibParams &getParams() const { return _params; }
+
+    void setSaturation(double satVal);
+    void setOutputSize(int w, int h);
+    void setSharpen(double amount);
+    void setWhiteBalance(double r, double g, double b);
+    void setColorMatrix(const double *m);
+    void setGamma(double gamma);
+    void setDemosaic(int mode);
+    void setPrecompose(bool on);
+    /** CalibParams::Backend, false (backend unchanged) if not available */
+    bool setBackend(int backend);
+    /** The backend in use, never BACKEND_AUTO */
+    int getBackend() const { return _backend->kind(); }
+
+    /** Stage timings of process() are reported to tracer, NULL disables */
+    void setTracer(IStageTracer *tracer) { _tracer = tracer; }
+
+    /** Size of the output image for an input of inWidth x inHeight */
+    void getOutputSize(int inWidth, int inHeight, int &outWidth, int &outHeight) const;
+
+    /**
+     * Process one frame. in is a raw Bayer (GB) mosaic, either FORMAT_MONO8 or
+     * replicated in FORMAT_RGB8. out is FORMAT_RGB8, FORMAT_MONO8, FORMAT_NV12 or
+     * FORMAT_I420 of the size returned by getOutputSize() and is written in place. Returns false on a size or format mismatch.
+     */
+    bool process(const ImageView &in, const ImageView &out);
+
+    /**
+     * Process one frame into several output formats at once, at most one view
+     * per format. Color processing and format conversion share the final pass;
+     * a mono output without color processing or RGB output is converted on
+     * the device so only the luma plane is downloaded.
+     */
+    bool process(const ImageView &in, const ImageView *outs, int count);
+
+    /**
+     * Register or move region of interest id: a w x h window at (x, y) of the
+     * undistorted image at input resolution, independent of the output size.
+     */
+    void setRoi(int id, int x, int y, int w, int h);
+    void removeRoi(int id);
+    /** Size of the crop of roi id for an input of inWidth x inHeight, false if unknown */
+    bool getRoiSize(int id, int inWidth, int inHeight, int &width, int &height) const;
+    /**
+     * Undistorted full resolution crop of roi id into out (FORMAT_RGB8 of
+     * getRoiSize()). Only the raw window the crop maps from is demosaiced and
+     * remapped, so the cost follows the crop size rather than the frame size.
+     */
+    bool processRoi(const ImageView &in, int id, const ImageView &out);
+};
+
+
+#endif
@@ -0,0 +1,76 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __CALIBPARAMS__
+#define __CALIBPARAMS__
+
+/**
+ * Camera calibration and processing parameters of CalibEngine.\n
+ * Calibration values follow PinholeCalibTool::configure, the defaults
+ * leave the colors untouched and keep the input size.
+ */
+struct CalibParams
+{
+    enum Demosaic {
+        DEMOSAIC_MHT = 0,
+        DEMOSAIC_BILINEAR = 1
+    };
+
+    enum Backend {
+        BACKEND_AUTO = 0,       ///< best available, see ProcessingBackend::best()
+        BACKEND_CUDA = 1,
+        BACKEND_OPENCL = 2,
+        BACKEND_CPU = 3
+    };
+
+    // calibration, valid for an image of calibWidth x calibHeight
+    int     calibWidth;
+    int     calibHeight;
+    double  fx, fy;
+    double  cx, cy;
+    double  k1, k2;
+    double  p1, p2;
+    bool    drawCenterCross;
+
+    // processing
+    int     backend;
+    int     demosaic;
+    int     outputWidth;        ///< 0 = input size
+    int     outputHeight;       ///< 0 = input size
+    bool    precompose;         ///< fold the output resize into the undistortion maps
+    double  sharpen;            ///< unsharp mask amount, 0 = off
+    double  saturation;         ///< offset on the 8 bit HSV saturation, 0 = off
+    double  whiteBalance[3];
+    double  colorMatrix[9];     ///< row-major
+    double  gamma;
+
+    CalibParams() {
+        calibWidth = 320;
+        calibHeight = 240;
+        fx = fy = 320.0;
+        cx = 160.0;
+        cy = 120.0;
+        k1 = k2 = p1 = p2 = 0.0;
+        drawCenterCross = false;
+
+        backend = BACKEND_AUTO;
+        demosaic = DEMOSAIC_MHT;
+        outputWidth = 0;
+        outputHeight = 0;
+        precompose = false;
+        sharpen = 0.0;
+        saturation = 0.0;
+        for (int i = 0; i < 3; i++)
+            whiteBalance[i] = 1.0;
+        for (int i = 0; i < 9; i++)
+            colorMatrix[i] = (i % 4 == 0) ? 1.0 : 0.0;
+        gamma = 1.0;
+    }
+};
+
+
+#endif
@@ -0,0 +1,72 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __CALIBTOOLGROUP__
+#define __CALIBTOOLGROUP__
+
+// std
+#include <vector>
+
+// iCub
+#include <iCub/ICalibTool.h>
+
+/**
+ * A set of identically configured calibration tools used by parallel
+ * frame workers. Configuration and parameter changes are forwarded to
+ * every member, apply() runs on the first member only. ROI calls go to
+ * the member added with addRoiTool() alone and are rejected without one.
+ * The group owns its members.
+ */
+class CalibToolGroup : public ICalibTool
+{
+private:
+
+    std::vector<ICalibTool*> _tools;
+    ICalibTool *_roiTool;
+
+public:
+
+    CalibToolGroup();
+    virtual ~CalibToolGroup();
+
+    /** Takes ownership of tool */
+    void add(ICalibTool *tool);
+    /** Takes ownership of tool, the only member ROI calls are forwarded to */
+    void addRoiTool(ICalibTool *tool);
+    int size() const { return (int)_tools.size(); }
+    ICalibTool *get(int i) { return _tools[i]; }
+
+    virtual bool open (yarp::os::Searchable &config);
+    virtual bool close ();
+    virtual bool configure (yarp::os::Searchable &config);
+
+    virtual void apply(const yarp::sig::ImageOf<yarp::sig::PixelRgb> & in,
+                       yarp::sig::ImageOf<yarp::sig::PixelRgb> & out);
+    virtual bool apply(const yarp::sig::ImageOf<yarp::sig::PixelRgb> & in, CalibOutputs & outs);
+
+    virtual void setSaturation(double satVal);
+    virtual void setOutputWidth(int w);
+    virtual void setOutputHeight(int h);
+    virtual void setOutputSize(int w, int h);
+    virtual void setSharpen(double amount);
+    virtual void setWhiteBalance(double r, double g, double b);
+    virtual void setColorMatrix(const double *m);
+    virtual void setGamma(double gamma);
+    virtual void setDemosaic(int mode);
+    virtual void setPrecompose(bool on);
+    virtual bool setBackend(int backend);
+    virtual int getBackend();
+    virtual void setRoi(int id, int x, int y, int w, int h);
+    virtual void removeRoi(int id);
+    virtual bool applyRoi(int id, const yarp::sig::ImageOf<yarp::sig::PixelRgb> & in,
+                          yarp::sig::ImageOf<yarp::sig::PixelRgb> & out);
+    /** Members run concurrently, stage tracing is disabled on all of them */
+    virtual void setTracer(FrameTracer *tracer);
+};
+
+
+#endif
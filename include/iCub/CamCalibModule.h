@@ -23,28 +23,114 @@
 #include <iCub/PinholeCalibTool.h>
 #include <iCub/CalibToolFactory.h>
 #include <iCub/ICalibTool.h>
+#include <iCub/FrameTracer.h>
+#include <iCub/ThreadPlacement.h>
+#include <iCub/JpegSliceEncoder.h>
+#include <iCub/FramePipeline.h>
+#include <iCub/FrameRecorder.h>
+#include <iCub/FrameReplay.h>
+#include <iCub/QualityController.h>
+#include <iCub/RoiPublisher.h>
 
 /**
  *
  * Camera Calibration Port class
  *
  */
-class CamCalibPort : public yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb> >
+class CamCalibPort : public yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb> >,
+                     public FramePipeline::Sink,
+                     public FrameReplay::Target
 {
 private:
     yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb> > *portImgOut;
+    yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelMono> > *portMono;
+    yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelMono> > *portNv12;
+    yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelMono> > *portI420;
     ICalibTool     *calibTool;
+    FrameTracer    *tracer;
+    yarp::os::BufferedPort<yarp::os::Bottle> *portCompressed;
+    JpegSliceEncoder *encoder;
+    FramePipeline  *pipeline;
+    FrameRecorder  *recorder;
+    QualityController *quality;
+    RoiPublisher   *rois;
+    ThreadPlacement placement;
+    bool placed;
+
+    /** Zero copy publishing state of one output port, see publish() */
+    struct OutputMode {
+        bool    copy;       ///< readers fell behind, frames go out of the port's own buffers
+        int     keptUp;     ///< copied frames sent before the next one, in a row
+        OutputMode() : copy(false), keptUp(0) {}
+    };
+    OutputMode modeRgb, modeMono, modeNv12, modeI420;
+    double lastPublish;
+
+    const yarp::sig::ImageOf<yarp::sig::PixelRgb> *warmFrame;
+    int warmFrames;
+    double warmFirst;
+    yarp::os::Semaphore warmMutex;
 
     bool verbose;
     double t0;
 
     virtual void onRead(yarp::sig::ImageOf<yarp::sig::PixelRgb> &yrpImgIn);
 
+    bool hasOutputs() const { return portImgOut!=NULL || portMono!=NULL || portNv12!=NULL || portI420!=NULL; }
+    /** Points outs to the next buffer of every output port in use */
+    void prepareOutputs(CalibOutputs &outs);
+    /** Gives the prepared buffers back without writing them */
+    void unprepareOutputs();
+    /** Writes the prepared output frames and the compressed copy, closes the traced frame */
+    void writeOutput(CalibOutputs &outs, yarp::os::Stamp &stamp);
+
+    template <class T>
+    static yarp::sig::ImageOf<T> *wrapOutput(yarp::os::BufferedPort<yarp::sig::ImageOf<T> > *port,
+                                             yarp::sig::ImageOf<T> &img, OutputMode &mode);
+    template <class T>
+    static void releaseOutput(yarp::os::BufferedPort<yarp::sig::ImageOf<T> > *port,
+                              OutputMode &mode, double budget);
+    template <class T>
+    static void writePort(yarp::os::BufferedPort<yarp::sig::ImageOf<T> > *port,
+                          const OutputMode &mode, yarp::os::Stamp &stamp);
+
 public:
     CamCalibPort();
     
     void setPointers(yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb> > *_portImgOut, ICalibTool *_calibTool);
+    /** Optional reduced format outputs, NULL = not produced */
+    void setFormatPorts(yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelMono> > *_portMono,
+                        yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelMono> > *_portNv12,
+                        yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelMono> > *_portI420);
+    /** Optional JPEG output, encoded after the raw frame is published */
+    void setCompressed(yarp::os::BufferedPort<yarp::os::Bottle> *_portCompressed, JpegSliceEncoder *_encoder);
     void setVerbose(const bool sw) { verbose=sw; }
+    void setTracer(FrameTracer *_tracer) { tracer=_tracer; }
+    /** Applied to the callback thread on the first frame */
+    void setPlacement(const ThreadPlacement &_placement) { placement=_placement; placed=false; }
+    /** Hand frames to parallel workers instead of processing them in the callback */
+    void setPipeline(FramePipeline *_pipeline) { pipeline=_pipeline; }
+    /** Frames received on the port are offered to the recorder */
+    void setRecorder(FrameRecorder *_recorder) { recorder=_recorder; }
+    /** Processing times are reported to the quality controller */
+    void setQuality(QualityController *_quality) { quality=_quality; }
+    /** Synthetic input and frame count for warmUp(), NULL = no warm-up */
+    void setWarmUp(const yarp::sig::ImageOf<yarp::sig::PixelRgb> *frame, int frames);
+    /** Slowest first warm-up frame so far [s] */
+    double getWarmUpFirst();
+    /** Runs the warm-up frames through tool into the configured output formats */
+    virtual void warmUp(ICalibTool *tool);
+
+    /** Full resolution crops computed from every input frame */
+    void setRois(RoiPublisher *_rois) { rois=_rois; }
+
+    // FrameReplay::Target, also the processing path of frames received on the port
+    virtual void process(const yarp::sig::ImageOf<yarp::sig::PixelRgb> &yrpImgIn, yarp::os::Stamp &stamp, double receive);
+
+    // FramePipeline::Sink
+    virtual void publish(CalibOutputs &outs, yarp::os::Stamp &stamp,
+                         double receive, double start, double end);
+    virtual void beforeApply(ICalibTool *tool);
 };
 
 
@@ -61,9 +147,20 @@ private:
 
     CamCalibPort    _prtImgIn;
     yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb> >  _prtImgOut;
+    yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelMono> > _prtMonoOut;
+    yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelMono> > _prtNv12Out;
+    yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelMono> > _prtI420Out;
+    yarp::os::BufferedPort<yarp::os::Bottle> _prtCompressed;
+    JpegSliceEncoder _encoder;
+    FrameRecorder * _recorder;
+    FrameReplay *   _replay;
+    RoiPublisher    _rois;
     yarp::os::Port  _configPort;
 
     ICalibTool *    _calibTool;
+    FramePipeline * _pipeline;
+    FrameTracer *   _tracer;
+    QualityController * _quality;
 
 public:
 
@@ -0,0 +1,96 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __COLORLUT__
+#define __COLORLUT__
+
+// std
+#include <vector>
+
+// opencv
+#include <opencv2/opencv.hpp>
+
+/**
+ * Color processing stage folding white balance, color correction matrix,
+ * gamma and saturation into a single cached 3D lookup table.\n
+ * The table is rebuilt lazily on the next apply() after a parameter changed
+ * and is applied to 8 bit RGB images with trilinear interpolation.
+ */
+class ColorLut
+{
+private:
+
+    int                 _nodes;
+
+    double              _wb[3];
+    double              _ccm[9];
+    double              _gamma;
+    double              _sat;
+
+    bool                _dirty;
+    cv::Mutex           _mutex;
+
+    std::vector<float>  _table;
+    cv::Mat             _channelTable;
+    int                 _idx[256];
+    float               _frac[256];
+
+    void rebuild();
+
+public:
+
+    /** nodes = number of lattice points per color axis */
+    ColorLut(int nodes = 33);
+
+    /** Per channel gains applied first (r, g, b) */
+    void setWhiteBalance(double r, double g, double b);
+    /** 3x3 row-major color correction matrix applied after white balance */
+    void setColorMatrix(const double *m);
+    /** Output encoding gamma, 1.0 = linear */
+    void setGamma(double g);
+    /** Offset added to the HSV saturation channel (0..255 scale), 0 = no change */
+    void setSaturation(double s);
+
+    /** True if the current parameters leave colors untouched */
+    bool isIdentity();
+
+    /** Apply in place, img must be CV_8UC3 in RGB order */
+    void apply(cv::Mat &img);
+
+    /** Rebuild the table if a parameter changed, must precede lookup() */
+    void prepare();
+
+    /**
+     * Per channel form for device backends: white balance and gamma as a
+     * 1x256 CV_8UC3 table (empty if they leave colors untouched), then the
+     * saturation offset on 8 bit HSV. False if a color matrix mixes channels.
+     */
+    bool getChannelStages(cv::Mat &table, double &saturation);
+
+    /** Color process one RGB pixel with trilinear interpolation, src and dst may alias */
+    inline void lookup(const unsigned char *src, unsigned char *dst) const {
+        const int sb = 3;
+        const int sg = _nodes * 3;
+        const int sr = _nodes * _nodes * 3;
+        const float fr = _frac[src[0]];
+        const float fg = _frac[src[1]];
+        const float fb = _frac[src[2]];
+        const float *c000 = &_table[0] + ((_idx[src[0]] * _nodes + _idx[src[1]]) * _nodes + _idx[src[2]]) * 3;
+        for (int c = 0; c < 3; c++) {
+            float c00 = c000[c]           + (c000[sb + c]           - c000[c])           * fb;
+            float c01 = c000[sg + c]      + (c000[sg + sb + c]      - c000[sg + c])      * fb;
+            float c10 = c000[sr + c]      + (c000[sr + sb + c]      - c000[sr + c])      * fb;
+            float c11 = c000[sr + sg + c] + (c000[sr + sg + sb + c] - c000[sr + sg + c]) * fb;
+            float c0 = c00 + (c01 - c00) * fg;
+            float c1 = c10 + (c11 - c10) * fg;
+            dst[c] = cv::saturate_cast<unsigned char>(c0 + (c1 - c0) * fr);
+        }
+    }
+};
+
+
+#endif
@@ -0,0 +1,131 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __FRAMEPIPELINE__
+#define __FRAMEPIPELINE__
+
+// std
+#include <vector>
+
+// yarp
+#include <yarp/os/Semaphore.h>
+#include <yarp/os/Stamp.h>
+#include <yarp/os/Thread.h>
+#include <yarp/sig/Image.h>
+
+// iCub
+#include <iCub/ICalibTool.h>
+#include <iCub/ThreadPlacement.h>
+
+/**
+ * Frame level parallelism: successive frames are processed concurrently by
+ * one worker thread per calibration tool and handed back in arrival order
+ * through a reorder buffer.\n
+ * push() copies the input into a free slot and blocks while all slots are
+ * in use, so the input port drops frames instead of queueing them. If the
+ * next frame in order is still missing maxWait seconds after a later frame
+ * finished, it is skipped and discarded once it completes.
+ */
+class FramePipeline
+{
+public:
+
+    /** Receives processed frames in order, called from the publisher thread */
+    class Sink {
+    public:
+        virtual ~Sink() {}
+        virtual void publish(CalibOutputs &outs, yarp::os::Stamp &stamp,
+                             double receive, double start, double end) = 0;
+        /** Called on a worker thread right before tool processes a frame */
+        virtual void beforeApply(ICalibTool *tool) {}
+        /** Called once on each placed worker thread before it takes frames */
+        virtual void warmUp(ICalibTool *tool) {}
+    };
+
+private:
+
+    enum SlotState { SLOT_FREE, SLOT_QUEUED, SLOT_BUSY, SLOT_DONE };
+
+    struct Slot {
+        SlotState                                   state;
+        unsigned int                                seq;
+        yarp::os::Stamp                             stamp;
+        double                                      receive;
+        double                                      start;
+        double                                      end;
+        bool                                        ok;
+        yarp::sig::ImageOf<yarp::sig::PixelRgb>     in;
+        yarp::sig::ImageOf<yarp::sig::PixelRgb>     rgb;
+        yarp::sig::ImageOf<yarp::sig::PixelMono>    mono;
+        yarp::sig::ImageOf<yarp::sig::PixelMono>    nv12;
+        yarp::sig::ImageOf<yarp::sig::PixelMono>    i420;
+        CalibOutputs                                outs;
+    };
+
+    class Worker : public yarp::os::Thread {
+    private:
+        FramePipeline   *pipeline;
+        ICalibTool      *tool;
+    public:
+        Worker(FramePipeline *_pipeline, ICalibTool *_tool) : pipeline(_pipeline), tool(_tool) {}
+        virtual void run() { pipeline->workerLoop(tool); }
+    };
+
+    class Publisher : public yarp::os::Thread {
+    private:
+        FramePipeline   *pipeline;
+    public:
+        Publisher(FramePipeline *_pipeline) : pipeline(_pipeline) {}
+        virtual void run() { pipeline->publisherLoop(); }
+    };
+
+    Sink                    *_sink;
+    double                  _maxWait;
+    ThreadPlacement         _workerPlacement;
+    ThreadPlacement         _publishPlacement;
+
+    std::vector<Slot*>      _slots;
+    std::vector<Worker*>    _workers;
+    Publisher               *_publisher;
+
+    yarp::os::Semaphore     _mutex;
+    yarp::os::Semaphore     _free;
+    yarp::os::Semaphore     _queued;
+    yarp::os::Semaphore     _done;
+    yarp::os::Semaphore     _warmed;
+
+    unsigned int            _pushSeq;
+    unsigned int            _nextSeq;
+    unsigned int            _dropped;
+    bool                    _running;
+
+    void workerLoop(ICalibTool *tool);
+    void publisherLoop();
+
+public:
+
+    /** One worker per tool, the tools are not owned */
+    FramePipeline(const std::vector<ICalibTool*> &tools, Sink *sink, double maxWait);
+    ~FramePipeline();
+
+    void setPlacement(const ThreadPlacement &workers, const ThreadPlacement &publisher);
+    /** Output formats produced for every frame, rgb only by default; call before start() */
+    void setOutputs(bool rgb, bool mono, bool nv12, bool i420);
+
+    /** Returns once every worker has been placed and has run Sink::warmUp() */
+    bool start();
+    /** Unblocks push() and joins all threads, frames in flight are discarded */
+    void stop();
+
+    void push(const yarp::sig::ImageOf<yarp::sig::PixelRgb> &in, const yarp::os::Stamp &stamp, double receive);
+
+    /** Frames skipped by the reorder buffer or rejected by a tool */
+    unsigned int getDropped();
+};
+
+
+#endif
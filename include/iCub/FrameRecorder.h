@@ -0,0 +1,78 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __FRAMERECORDER__
+#define __FRAMERECORDER__
+
+// std
+#include <string>
+#include <vector>
+
+// yarp
+#include <yarp/os/Semaphore.h>
+#include <yarp/os/Stamp.h>
+#include <yarp/os/Thread.h>
+#include <yarp/sig/Image.h>
+
+// iCub
+#include <iCub/RawRecording.h>
+
+/**
+ * Records the raw input stream to a RawRecording file.\n
+ * push() copies the frame into a bounded queue and returns, a writer thread
+ * appends the queued frames to the file, so disk stalls never block the
+ * input callback. Frames arriving while the queue is full are dropped and
+ * counted.
+ */
+class FrameRecorder : public yarp::os::Thread
+{
+private:
+
+    struct Entry {
+        yarp::sig::ImageOf<yarp::sig::PixelRgb>     img;
+        unsigned int                                seq;
+        double                                      stamp;
+        double                                      receive;
+    };
+
+    RawRecordingWriter      _writer;
+    std::vector<Entry*>     _queue;
+    int                     _head;
+    int                     _count;
+    unsigned int            _dropped;
+    unsigned int            _writeErrors;
+    bool                    _recording;
+    std::string             _file;
+
+    yarp::os::Semaphore     _mutex;
+    yarp::os::Semaphore     _items;
+    yarp::os::Semaphore     _control;
+
+public:
+
+    FrameRecorder(int queue = 16, int chunkFrames = 64);
+    ~FrameRecorder();
+
+    /** Starts recording into file, stops a running recording first */
+    bool record(const std::string &file);
+    /** Writes the queued frames and closes the file */
+    void stopRecording();
+    bool isRecording();
+
+    /** Queue a received frame, call from a single thread */
+    void push(const yarp::sig::ImageOf<yarp::sig::PixelRgb> &img, const yarp::os::Stamp &stamp, double receive);
+
+    /** Summary of the current or last recording */
+    std::string status();
+
+    // Thread
+    virtual void run();
+    virtual void onStop();
+};
+
+
+#endif
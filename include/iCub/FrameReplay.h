@@ -0,0 +1,74 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __FRAMEREPLAY__
+#define __FRAMEREPLAY__
+
+// std
+#include <string>
+
+// yarp
+#include <yarp/os/Semaphore.h>
+#include <yarp/os/Stamp.h>
+#include <yarp/os/Thread.h>
+#include <yarp/sig/Image.h>
+
+// iCub
+#include <iCub/RawRecording.h>
+
+/**
+ * Replays a RawRecording as input stream.\n
+ * Frames are wrapped in place as YARP images on the memory mapping and
+ * handed to the target without a copy, either at the recorded timing
+ * (scaled by speed) or as fast as the target accepts them (speed 0).
+ */
+class FrameReplay : public yarp::os::Thread
+{
+public:
+
+    /** Receives replayed frames, called from the replay thread */
+    class Target {
+    public:
+        virtual ~Target() {}
+        virtual void process(const yarp::sig::ImageOf<yarp::sig::PixelRgb> &img, yarp::os::Stamp &stamp, double receive) = 0;
+    };
+
+private:
+
+    RawRecordingReader  _reader;
+    Target              *_target;
+    double              _speed;
+    bool                _loop;
+
+    yarp::os::Semaphore _mutex;
+    bool                _done;
+    unsigned int        _fed;
+    double              _elapsed;
+
+public:
+
+    FrameReplay();
+
+    /** Maps the file and checks that all frames can be fed as rgb images */
+    bool open(const std::string &file);
+    void setTarget(Target *target) { _target = target; }
+    /** 1.0 = recorded timing, 0 = flat out */
+    void setSpeed(double speed) { _speed = speed < 0 ? 0 : speed; }
+    void setLoop(bool loop) { _loop = loop; }
+
+    int count() const { return _reader.count(); }
+    /** True once the last frame was fed (never with looping) */
+    bool isDone();
+    /** Frames fed and seconds spent so far */
+    void getProgress(unsigned int &fed, double &elapsed);
+
+    // Thread
+    virtual void run();
+};
+
+
+#endif
@@ -0,0 +1,101 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __FRAMETRACER__
+#define __FRAMETRACER__
+
+// std
+#include <string>
+#include <vector>
+
+// yarp
+#include <yarp/os/Bottle.h>
+#include <yarp/os/Semaphore.h>
+
+// iCub
+#include <iCub/IStageTracer.h>
+
+/**
+ * Per frame latency tracing.\n
+ * Records capture stamp, receive time, the start and end of each processing
+ * stage and the publish time of every frame into a ring buffer. The buffer
+ * can be dumped as Chrome trace / Perfetto JSON and a capture-to-publish
+ * latency histogram is kept over all traced frames.\n
+ * All recording calls are no-ops while tracing is disabled. Recording is
+ * expected from a single thread, dump() and getStats() may be called from any.
+ */
+class FrameTracer : public IStageTracer
+{
+public:
+
+    enum { MAX_STAGES = 16, HIST_BINS = 11 };
+
+    struct Stage {
+        const char *name;
+        double      start;
+        double      end;
+    };
+
+    struct Record {
+        unsigned int seq;
+        double       capture;
+        double       receive;
+        double       publish;
+        int          nStages;
+        Stage        stages[MAX_STAGES];
+    };
+
+private:
+
+    bool                    _enabled;       ///< processing thread only
+    bool                    _requested;     ///< set by setEnabled(), taken over in beginFrame()
+    yarp::os::Semaphore     _mutex;
+
+    std::vector<Record>     _ring;
+    size_t                  _head;
+    size_t                  _count;
+    unsigned int            _seq;
+
+    // processing thread only, other threads go through _requested
+    Record                  _current;
+    bool                    _inFrame;
+
+    unsigned int            _hist[HIST_BINS];
+    double                  _latSum;
+    double                  _latMax;
+    unsigned int            _latCount;
+
+public:
+
+    /** capacity = number of frames kept in the ring buffer */
+    FrameTracer(int capacity = 1024);
+
+    /** Takes effect at the next beginFrame() */
+    void setEnabled(bool on);
+    bool isEnabled();
+
+    /** capture = envelope stamp time (<= 0 if unknown), receive = arrival time */
+    void beginFrame(double capture, double receive);
+    /** name must point to a string with static lifetime */
+    virtual void beginStage(const char *name);
+    virtual void endStage();
+    /** Stage measured elsewhere, e.g. on a worker thread */
+    void addStage(const char *name, double start, double end);
+    void endFrame(double publish);
+
+    /** Write the ring buffer as Chrome trace JSON, false on I/O error */
+    bool dump(const std::string &file);
+
+    /** Append latency statistics (count, mean, max, histogram in ms) to reply */
+    void getStats(yarp::os::Bottle &reply);
+
+    /** Clear ring buffer and histogram */
+    void reset();
+};
+
+
+#endif
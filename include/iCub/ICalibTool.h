@@ -13,6 +13,27 @@
 #include <yarp/sig/Image.h>
 #include <yarp/os/IConfig.h>
 
+// iCub
+#include <iCub/CalibParams.h>
+
+class FrameTracer;
+
+/**
+ * Output buffers filled by one ICalibTool::apply() call, NULL = not wanted.\n
+ * The 4:2:0 formats are stored as mono images of height * 3 / 2 rows with
+ * tightly packed rows: the Y plane followed by interleaved U V (nv12) or by
+ * the U and then the V plane (i420).
+ */
+struct CalibOutputs
+{
+    yarp::sig::ImageOf<yarp::sig::PixelRgb>     *rgb;
+    yarp::sig::ImageOf<yarp::sig::PixelMono>    *mono;
+    yarp::sig::ImageOf<yarp::sig::PixelMono>    *nv12;
+    yarp::sig::ImageOf<yarp::sig::PixelMono>    *i420;
+
+    CalibOutputs() : rgb(NULL), mono(NULL), nv12(NULL), i420(NULL) {}
+};
+
 /**
  * Interface to calibrate and project input image based on camera's internal parameters and projection mode\n
  */
@@ -21,6 +42,20 @@ class ICalibTool : public yarp::os::IConfig
 
 public:
 
+    /** Demosaicing algorithms selectable via setDemosaic() */
+    enum DemosaicMode {
+        DEMOSAIC_MHT = CalibParams::DEMOSAIC_MHT,
+        DEMOSAIC_BILINEAR = CalibParams::DEMOSAIC_BILINEAR
+    };
+
+    /** Processing backends selectable via setBackend() */
+    enum Backend {
+        BACKEND_AUTO = CalibParams::BACKEND_AUTO,
+        BACKEND_CUDA = CalibParams::BACKEND_CUDA,
+        BACKEND_OPENCL = CalibParams::BACKEND_OPENCL,
+        BACKEND_CPU = CalibParams::BACKEND_CPU
+    };
+
     // IConfig
     virtual bool open (yarp::os::Searchable &config) = 0;
     virtual bool close () = 0;
@@ -28,11 +63,33 @@ public:
 
     virtual void apply(const yarp::sig::ImageOf<yarp::sig::PixelRgb> & in,
                        yarp::sig::ImageOf<yarp::sig::PixelRgb> & out) = 0;
+    /** Process one frame into all requested output formats at once, false if outs must not be published */
+    virtual bool apply(const yarp::sig::ImageOf<yarp::sig::PixelRgb> & in, CalibOutputs & outs) = 0;
 
     virtual void setSaturation(double satVal) = 0;
 	virtual void setOutputWidth(int w) = 0;
 	virtual void setOutputHeight(int h) = 0;
+	/** Both output dimensions in one call, so no frame sees half a change */
+	virtual void setOutputSize(int w, int h) = 0;
 	virtual void setSharpen(double amount) = 0;
+	virtual void setWhiteBalance(double r, double g, double b) = 0;
+	virtual void setColorMatrix(const double *m) = 0;
+	virtual void setGamma(double gamma) = 0;
+	virtual void setDemosaic(int mode) = 0;
+	/** Fold the output resize into the undistortion maps (single remap pass) */
+	virtual void setPrecompose(bool on) = 0;
+	/** Runtime selected compute backend, false if not available on this host */
+	virtual bool setBackend(int backend) = 0;
+	/** Backend in use, never BACKEND_AUTO */
+	virtual int getBackend() = 0;
+	/** Register or move roi id, a w x h window at (x, y) of the undistorted input resolution image */
+	virtual void setRoi(int id, int x, int y, int w, int h) = 0;
+	virtual void removeRoi(int id) = 0;
+	/** Full resolution crop of roi id computed from the raw input, false if unknown */
+	virtual bool applyRoi(int id, const yarp::sig::ImageOf<yarp::sig::PixelRgb> & in,
+	                      yarp::sig::ImageOf<yarp::sig::PixelRgb> & out) = 0;
+	/** Stage timings of apply() are reported to tracer, NULL disables */
+	virtual void setTracer(FrameTracer *tracer) = 0;
 };
 
 
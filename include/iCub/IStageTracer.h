@@ -0,0 +1,25 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __ISTAGETRACER__
+#define __ISTAGETRACER__
+
+/**
+ * Receives the start and end of the processing stages of one frame.
+ */
+class IStageTracer
+{
+public:
+    virtual ~IStageTracer() {}
+
+    /** name must point to a string with static lifetime */
+    virtual void beginStage(const char *name) = 0;
+    virtual void endStage() = 0;
+};
+
+
+#endif
@@ -0,0 +1,43 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __IMAGEVIEW__
+#define __IMAGEVIEW__
+
+/**
+ * Non-owning view of an 8 bit image in caller memory.\n
+ * stride is the distance in bytes between the starts of two rows of the
+ * first plane. In the 4:2:0 formats the chroma planes follow the luma plane
+ * directly: NV12 has one interleaved UV plane with the same stride, I420 a U
+ * and then a V plane with stride/2. Width and height must be even for these.
+ */
+struct ImageView
+{
+    enum Format {
+        FORMAT_MONO8 = 0,   ///< one byte per pixel, e.g. a raw Bayer mosaic
+        FORMAT_RGB8  = 1,   ///< three bytes per pixel, R G B
+        FORMAT_NV12  = 2,   ///< Y plane, then interleaved U V at half resolution
+        FORMAT_I420  = 3    ///< Y plane, then U and V planes at half resolution
+    };
+
+    unsigned char   *data;
+    int             width;
+    int             height;
+    int             stride;
+    Format          format;
+
+    ImageView() : data(0), width(0), height(0), stride(0), format(FORMAT_RGB8) {}
+
+    ImageView(unsigned char *_data, int _width, int _height, int _stride, Format _format) :
+        data(_data), width(_width), height(_height), stride(_stride), format(_format) {}
+
+    /** Bytes per pixel of the first plane */
+    int channels() const { return format == FORMAT_RGB8 ? 3 : 1; }
+};
+
+
+#endif
@@ -0,0 +1,52 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __JPEGSLICEENCODER__
+#define __JPEGSLICEENCODER__
+
+// std
+#include <vector>
+
+// opencv
+#include <opencv2/opencv.hpp>
+
+// yarp
+#include <yarp/os/Bottle.h>
+
+/**
+ * Encodes an RGB frame as independent JPEG slices in parallel.\n
+ * The frame is split into horizontal bands (multiples of 16 rows) that are
+ * encoded concurrently on the OpenCV worker pool. The result is written to
+ * a bottle:\n
+ * <tt>(jpeg width height quality) ((y0 rows0 {blob0}) (y1 rows1 {blob1}) ...)</tt>\n
+ * Each blob is a complete JPEG file of its band, decode with cv::imdecode
+ * (BGR) and paste at row y.
+ */
+class JpegSliceEncoder
+{
+private:
+
+    int                                 _quality;
+    int                                 _slices;
+    std::vector<cv::Mat>                _scratch;
+    std::vector<std::vector<uchar> >    _buffers;
+
+public:
+
+    JpegSliceEncoder();
+
+    /** JPEG quality 0..100 */
+    void setQuality(int q);
+    /** Number of bands, 0 = one per OpenCV worker thread */
+    void setSlices(int n);
+
+    /** rgb must be CV_8UC3 in RGB order, it is only read */
+    void encode(const cv::Mat &rgb, yarp::os::Bottle &out);
+};
+
+
+#endif
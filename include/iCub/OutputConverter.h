@@ -0,0 +1,38 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __OUTPUTCONVERTER__
+#define __OUTPUTCONVERTER__
+
+// opencv
+#include <opencv2/opencv.hpp>
+
+// iCub
+#include <iCub/ImageView.h>
+#include <iCub/ColorLut.h>
+
+/**
+ * Final stage for the reduced output formats: color processing and pixel
+ * format conversion of a processed RGB frame in a single pass.\n
+ * Mono is full range luma (as CV_RGB2GRAY), NV12 and I420 use BT.601 video
+ * range with chroma averaged over 2x2 pixels, as expected by most encoders.
+ */
+class OutputConverter
+{
+public:
+
+    /**
+     * Convert rgb (CV_8UC3, RGB order) into out, which must have the same size
+     * and be FORMAT_MONO8, FORMAT_NV12 or FORMAT_I420. If lut is not NULL every
+     * pixel is color processed on the way, it must have been prepared.
+     * Returns false on a size or format mismatch.
+     */
+    static bool convert(const cv::Mat &rgb, const ImageView &out, const ColorLut *lut);
+};
+
+
+#endif
@@ -15,16 +15,6 @@
 #include <stdio.h>
 #include <math.h>
 
-// opencv
-#include <opencv2/opencv.hpp>
-#include <opencv2/core/version.hpp>
-#if CV_MAJOR_VERSION == 2
-    #include <opencv2/gpu/gpu.hpp>
-#elif CV_MAJOR_VERSION == 3
-    #include "opencv2/cudaarithm.hpp"
-    #include "opencv2/cudafilters.hpp"
-#endif
-
 // yarp
 //#include <yarp/sig/Image.h>
 #include <yarp/sig/all.h>
@@ -34,50 +24,21 @@
 
 // iCub
 #include <iCub/ICalibTool.h>
+#include <iCub/CalibEngine.h>
+#include <iCub/FrameTracer.h>
 
 
 /**
  * Class to calibrate input image based on camera's internal parameters\n
- * Configuration: See PinholeCalibTool::configure
+ * Configuration: See PinholeCalibTool::configure\n
+ * Thin YARP adapter over CalibEngine from the camcalib_core library.
  */
 
 class PinholeCalibTool : public ICalibTool
 {
  private:
     
-    CvMat           *_intrinsic_matrix;
-    CvMat           *_intrinsic_matrix_scaled;
-    CvMat           *_distortion_coeffs;;
-
-    IplImage        *_mapUndistortX;
-    IplImage        *_mapUndistortY;
-
-#if CV_MAJOR_VERSION == 2
-	cv::gpu::GpuMat gpuundistx;
-	cv::gpu::GpuMat gpuundisty;
-    cv::gpu::GpuMat gpuundisttmp;
-	std::vector<cv::gpu::GpuMat> gpumatvec;
-#elif CV_MAJOR_VERSION == 3
-    cv::cuda::GpuMat gpuundistx;
-    cv::cuda::GpuMat gpuundisty;
-    cv::cuda::GpuMat gpuundisttmp;
-    std::vector<cv::cuda::GpuMat> gpumatvec;
-#endif
-
-    bool _needInit;
-
-    CvSize          _calibImgSize;
-    CvSize          _oldImgSize;
-
-    bool _drawCenterCross;
-
-    bool init(CvSize currImgSize, CvSize calibImgSize);
-
-	double currSat;
-	int outputWidth;
-	int outputHeight;
-	double sharpenVal;
-	
+    CalibEngine     _engine;
 
 public:
 
@@ -124,10 +85,26 @@ public:
     void apply(const yarp::sig::ImageOf<yarp::sig::PixelRgb> & in,
                yarp::sig::ImageOf<yarp::sig::PixelRgb> & out);
 
+    /** Apply calibration into every non-NULL output of outs, resized as needed */
+    bool apply(const yarp::sig::ImageOf<yarp::sig::PixelRgb> & in, CalibOutputs & outs);
+
 	void setSaturation(double satVal);
 	void setOutputWidth(int w);
 	void setOutputHeight(int h);
+	void setOutputSize(int w, int h);
 	void setSharpen(double amount);
+	void setWhiteBalance(double r, double g, double b);
+	void setColorMatrix(const double *m);
+	void setGamma(double gamma);
+	void setDemosaic(int mode);
+	void setPrecompose(bool on);
+	bool setBackend(int backend);
+	int getBackend();
+	void setRoi(int id, int x, int y, int w, int h);
+	void removeRoi(int id);
+	bool applyRoi(int id, const yarp::sig::ImageOf<yarp::sig::PixelRgb> & in,
+	              yarp::sig::ImageOf<yarp::sig::PixelRgb> & out);
+	void setTracer(FrameTracer *t);
 };
 
 
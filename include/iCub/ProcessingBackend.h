@@ -0,0 +1,78 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __PROCESSINGBACKEND__
+#define __PROCESSINGBACKEND__
+
+// std
+#include <string>
+
+// opencv
+#include <opencv2/opencv.hpp>
+
+// iCub
+#include <iCub/CalibParams.h>
+
+/**
+ * Image stages of CalibEngine on one compute device.\n
+ * A backend holds the current frame between the stage calls of process():
+ * upload(), demosaic(), remap(), optionally color() and sharpen(), then
+ * download() or downloadGray(). Implementations are CUDA (OpenCV gpu/cuda modules, if
+ * built in), OpenCL through the transparent API (cv::UMat, OpenCV 3) and
+ * plain CPU; which of them exist is decided at runtime.\n
+ * The CUDA backend demosaics with MHT, the others use edge aware (OpenCV 2:
+ * VNG) interpolation for CalibParams::DEMOSAIC_MHT. Those two defer
+ * demosaicing to remap(); the CPU backend runs both per cache sized tile
+ * (see TiledRemap).
+ */
+class ProcessingBackend
+{
+public:
+
+    virtual ~ProcessingBackend() {}
+
+    /** CalibParams::Backend of this implementation */
+    virtual int kind() const = 0;
+
+    /** Undistortion maps (CV_32FC1) used by remap() until replaced */
+    virtual void setMaps(const cv::Mat &mapx, const cv::Mat &mapy) = 0;
+
+    /** Raw GB mosaic, CV_8UC1 or replicated in CV_8UC3 */
+    virtual void upload(const cv::Mat &in) = 0;
+    /** CalibParams::Demosaic */
+    virtual void demosaic(int mode) = 0;
+    /** Remap with the current maps, then resize to size unless it is empty */
+    virtual void remap(const cv::Size &size) = 0;
+    /**
+     * Per channel table (1x256 CV_8UC3, skipped if empty), then an offset on
+     * the 8 bit HSV saturation, see ColorLut::getChannelStages(). False if
+     * this backend leaves color processing to the host.
+     */
+    virtual bool color(const cv::Mat &table, double saturation) = 0;
+    /** Unsharp mask */
+    virtual void sharpen(double amount) = 0;
+    /** Current frame into rgb (CV_8UC3 of the frame size, caller memory) */
+    virtual void download(cv::Mat &rgb) = 0;
+    /** Luma of the current frame into gray (CV_8UC1, caller memory), converted on the device */
+    virtual void downloadGray(cv::Mat &gray) = 0;
+
+    /** Compiled in and a device or runtime present on this host */
+    static bool isAvailable(int kind);
+    /** CUDA if a device is present, else OpenCL on a GPU, else CPU */
+    static int best();
+    /** NULL if kind is not available, BACKEND_AUTO creates best() */
+    static ProcessingBackend *create(int kind);
+
+    static const char *name(int kind);
+    /** "auto", "cuda", "opencl" or "cpu" */
+    static bool parse(const std::string &name, int &kind);
+    /** Algorithm kind really runs for CalibParams::Demosaic mode: "mht", "ea", "vng" or "bilinear" */
+    static const char *demosaicName(int kind, int mode);
+};
+
+
+#endif
@@ -0,0 +1,117 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __QUALITYCONTROLLER__
+#define __QUALITYCONTROLLER__
+
+// std
+#include <map>
+#include <string>
+#include <vector>
+
+// yarp
+#include <yarp/os/Bottle.h>
+#include <yarp/os/Searchable.h>
+#include <yarp/os/Semaphore.h>
+
+// iCub
+#include <iCub/ICalibTool.h>
+
+/**
+ * Trades quality for frame rate under overload.\n
+ * Per-frame processing times are averaged over windows of frames and compared
+ * with the frame interval of the target rate. When a window's load exceeds the
+ * down threshold the next quality step is applied (level + 1); after several
+ * consecutive windows below the up threshold the last step is undone. Levels
+ * are cumulative: level n applies the first n configured steps.\n
+ * A new level is only recorded; every tool picks it up in sync(), called by
+ * the thread that runs the tool right before its next apply(), so settings
+ * never change under a frame in progress.
+ */
+class QualityController
+{
+public:
+
+    enum Step {
+        STEP_SHARPEN,       ///< sharpening off
+        STEP_DEMOSAIC,      ///< bilinear instead of MHT demosaicing
+        STEP_DOWNSCALE      ///< output downscaled, resize folded into the maps
+    };
+
+    /** The configured full quality settings, restored at level 0; also the settings of a level */
+    struct Baseline {
+        double  sharpen;
+        int     demosaic;
+        bool    precompose;
+        int     outWidth;
+        int     outHeight;
+    };
+
+private:
+
+    Baseline            _base;
+    std::vector<int>    _steps;
+
+    double              _budget;
+    int                 _parallel;
+    double              _downscale;
+    int                 _window;
+    double              _downLoad;
+    double              _upLoad;
+    int                 _upWindows;
+
+    yarp::os::Semaphore _mutex;
+    bool                _enabled;
+    bool                _auto;
+    int                 _level;
+    double              _sum;
+    int                 _count;
+    int                 _calmWindows;
+    double              _load;
+    unsigned int        _changes;
+    int                 _inWidth;
+    int                 _inHeight;
+
+    Baseline            _pending;       ///< settings of the current level
+    unsigned int        _generation;    ///< bumped on every level change
+    std::map<ICalibTool*, unsigned int> _synced;
+
+    void applyLevel(int level);
+    static const char *stepName(int step);
+
+public:
+
+    QualityController(const Baseline &base);
+
+    /** Reads targetfps and the quality options, adaptation is off without targetfps */
+    void configure(yarp::os::Searchable &config, int parallelFrames);
+    bool isEnabled() const { return _enabled; }
+
+    /** Input frame size, the downscale step scales it when no output size is set */
+    void setInputSize(int width, int height);
+    /** Report the processing time of one frame, from the thread that publishes frames */
+    void update(double seconds);
+
+    /**
+     * Applies the settings of the current level to tool if it has not seen
+     * them yet. Call from the thread running tool, right before its apply().
+     */
+    void sync(ICalibTool *tool);
+
+    /** Fix the level (disables adaptation), false if out of range */
+    bool setLevel(int level);
+    /** Resume adaptation from the current level */
+    void setAuto();
+
+    int getLevel();
+
+    /** Flat key value pairs: level, step, levels, auto, load, changes */
+    void getStats(yarp::os::Bottle &reply);
+};
+
+
+#endif
@@ -0,0 +1,122 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __RAWRECORDING__
+#define __RAWRECORDING__
+
+// std
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+// iCub
+#include <iCub/ImageView.h>
+
+/**
+ * Raw frame recording file.\n
+ * A 64 byte file header is followed by blocks, each starting on a 64 byte
+ * boundary with a RawBlockHeader. Frame blocks hold one frame exactly as
+ * received plus its stamps, the pixel data starting right after the 64 byte
+ * frame header. Every chunk of frames is closed by an index block listing the
+ * frame offsets of the chunk and pointing to the previous index block; the
+ * trailer points to the last one. A file without trailer (recorder killed)
+ * is recovered by scanning the blocks.
+ */
+struct RawBlockHeader
+{
+    char        magic[4];       ///< "FRME", "INDX" or "TRLR"
+    uint32_t    reserved;
+    uint64_t    size;           ///< whole block including this header and padding
+};
+
+struct RawFrameHeader
+{
+    RawBlockHeader  block;
+    uint32_t        width;
+    uint32_t        height;
+    uint32_t        stride;
+    uint32_t        format;     ///< ImageView::Format
+    uint32_t        rowAlign;   ///< row alignment of the producer, e.g. the YARP image quantum
+    uint32_t        seq;
+    double          stamp;      ///< envelope time, -1 if the frame had no stamp
+    double          receive;
+    uint32_t        reserved[2];
+};
+
+/** Per frame data of a recording besides the pixels */
+struct RawFrameInfo
+{
+    unsigned int    seq;
+    double          stamp;
+    double          receive;
+    int             rowAlign;
+};
+
+/** Appends frames to a recording, synchronously */
+class RawRecordingWriter
+{
+private:
+
+    FILE                    *_file;
+    uint64_t                _offset;
+    uint64_t                _lastIndex;
+    std::vector<uint64_t>   _chunk;
+    int                     _chunkFrames;
+    unsigned long           _frames;
+
+    bool writeBlock(const void *header, size_t headerSize, const void *data, size_t dataSize);
+    bool writeIndex();
+
+public:
+
+    /** An index block is written every chunkFrames frames */
+    RawRecordingWriter(int chunkFrames = 64);
+    ~RawRecordingWriter();
+
+    bool open(const char *file);
+    /** Writes the pending index and the trailer */
+    bool close();
+    bool isOpen() const { return _file != NULL; }
+    unsigned long frames() const { return _frames; }
+
+    bool append(const ImageView &frame, unsigned int seq, double stamp, double receive, int rowAlign = 1);
+};
+
+/**
+ * Memory-mapped access to a recording, frames are returned as views into the
+ * mapping and are valid until close().
+ */
+class RawRecordingReader
+{
+private:
+
+    unsigned char           *_base;
+    size_t                  _size;
+    std::vector<unsigned char> _buffer;
+    std::vector<uint64_t>   _frames;
+    bool                    _recovered;
+
+    bool readIndex();
+    void scanBlocks();
+
+public:
+
+    RawRecordingReader();
+    ~RawRecordingReader();
+
+    bool open(const char *file);
+    void close();
+
+    int count() const { return (int)_frames.size(); }
+    /** True if the index was missing or damaged and the frames were found by scanning */
+    bool recovered() const { return _recovered; }
+
+    bool frame(int i, ImageView &view, RawFrameInfo &info) const;
+};
+
+
+#endif
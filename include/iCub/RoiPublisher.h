@@ -0,0 +1,90 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __ROIPUBLISHER__
+#define __ROIPUBLISHER__
+
+// std
+#include <string>
+#include <vector>
+
+// yarp
+#include <yarp/os/Bottle.h>
+#include <yarp/os/BufferedPort.h>
+#include <yarp/os/Semaphore.h>
+#include <yarp/os/Stamp.h>
+#include <yarp/sig/Image.h>
+
+// iCub
+#include <iCub/ICalibTool.h>
+
+/**
+ * Named full resolution crops (foveae) of the undistorted image, each
+ * published on its own port <prefix><name>.\n
+ * Crops are computed from the raw input frame through the matching window
+ * of the undistortion maps, so they stay sharp when the main output is
+ * downscaled. A crop is only computed while its port has a reader. Regions
+ * are added, moved and removed at runtime, typically over rpc; the tool
+ * picks the changes up at the next process() call, on the processing thread.
+ */
+class RoiPublisher
+{
+private:
+
+    struct Roi {
+        std::string     name;
+        int             id;
+        int             cx, cy, w, h;
+        yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb> > port;
+    };
+
+    /** Pending setRoi (remove false) or removeRoi on the tool */
+    struct Change {
+        int             id;
+        bool            remove;
+        int             x, y, w, h;
+    };
+
+    ICalibTool              *_tool;
+    std::string             _prefix;
+    std::vector<Roi*>       _rois;
+    std::vector<Change>     _changes;
+    int                     _nextId;
+    yarp::os::Semaphore     _mutex;
+
+    Roi *find(const std::string &name);
+
+public:
+
+    RoiPublisher();
+    ~RoiPublisher();
+
+    /** Tool computing the crops, used from the processing thread only, also for roi changes */
+    void setTool(ICalibTool *tool) { _tool = tool; }
+    ICalibTool *getTool() { return _tool; }
+    /** Port name prefix, e.g. /camCalib/roi/ */
+    void setPrefix(const std::string &prefix) { _prefix = prefix; }
+
+    /**
+     * Add roi name, a w x h crop centered at (cx, cy) of the undistorted
+     * input resolution image, or move and resize it if it exists.
+     */
+    bool add(const std::string &name, int cx, int cy, int w, int h);
+    bool remove(const std::string &name);
+    /** Appends (name cx cy w h) for every roi */
+    void list(yarp::os::Bottle &reply);
+
+    /** Compute and publish the crops of a raw input frame with its stamp */
+    void process(const yarp::sig::ImageOf<yarp::sig::PixelRgb> &in, yarp::os::Stamp &stamp);
+
+    void interrupt();
+    /** Closes all ports and forgets all rois */
+    void close();
+};
+
+
+#endif
@@ -0,0 +1,90 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __THREADPLACEMENT__
+#define __THREADPLACEMENT__
+
+// std
+#include <vector>
+#include <string>
+
+// yarp
+#include <yarp/os/Searchable.h>
+#include <yarp/os/Thread.h>
+
+/**
+ * CPU affinity, real-time priority and NUMA memory policy for a thread.\n
+ * Only supported on Linux, elsewhere apply() reports and does nothing.
+ */
+class ThreadPlacement
+{
+private:
+
+    std::vector<int>    _cores;
+    int                 _priority;
+    bool                _numaLocal;
+
+public:
+
+    ThreadPlacement();
+
+    /**
+     * Reads the core list from coresKey, e.g. "proccores (2 3)" or "proccores 2",
+     * "<prefix>rtpriority" (SCHED_FIFO priority, 0 = normal scheduling) and
+     * "<prefix>numalocal" (allocate memory on the node the thread runs on).
+     */
+    void configure(yarp::os::Searchable &config, const char *coresKey, const char *prefix = "");
+
+    bool isSet() const { return !_cores.empty() || _priority > 0 || _numaLocal; }
+    const std::vector<int> &cores() const { return _cores; }
+
+    /** Core list from key, either a single int or a list */
+    static std::vector<int> parseCores(yarp::os::Searchable &config, const char *key);
+
+    /** Apply to the calling thread, what is used for messages only */
+    bool apply(const char *what) const;
+
+    /**
+     * Place the OpenCV worker pool on cores.
+     * The pool threads inherit the affinity of the thread that spawns them,
+     * so the calling thread temporarily takes the worker cores while the pool
+     * is (re)started. Backends that keep their threads (TBB, OpenMP) are
+     * pinned from inside a parallel loop instead, which reaches only the
+     * threads that take part in it; false with a warning if some pool
+     * thread was missed. threads = pool size, 0 = one thread per core.
+     */
+    static bool placeWorkerPool(const std::vector<int> &cores, int threads = 0);
+};
+
+/**
+ * One-off work done on a temporary thread with a given placement, so the
+ * memory it first touches (maps, buffers) is local to where the long
+ * running thread with the same placement will use it.
+ */
+class PlacedJob : public yarp::os::Thread
+{
+private:
+
+    ThreadPlacement     _placement;
+    std::string         _what;
+
+public:
+
+    PlacedJob(const ThreadPlacement &placement, const char *what) : _placement(placement), _what(what) {}
+
+    /** The work, called on the placed thread */
+    virtual void job() = 0;
+
+    /** Runs job() on a new placed thread and waits for it to finish */
+    bool runPlaced();
+
+    // Thread
+    virtual void run();
+};
+
+
+#endif
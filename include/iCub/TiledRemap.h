@@ -0,0 +1,74 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#ifndef __TILEDREMAP__
+#define __TILEDREMAP__
+
+// std
+#include <vector>
+
+// opencv
+#include <opencv2/opencv.hpp>
+
+/**
+ * Cache blocked demosaicing and remap of raw Bayer frames on the CPU.\n
+ * The output is cut into square tiles, the largest whose raw window (the
+ * source footprint of its maps), demosaiced window and own maps and pixels
+ * fit in half the L2 cache. Each tile's fixed point maps are stored
+ * contiguously and relative to its raw window, so per frame a tile
+ * demosaics just that window and remaps from it while it is still cached;
+ * the full demosaiced frame is never written to memory. Tiles are visited
+ * in serpentine order and spread over the OpenCV worker pool.\n
+ * The tiling is built on the first apply() after setMaps(), when the raw
+ * frame size is known.
+ */
+class TiledRemap
+{
+private:
+
+    struct Tile {
+        cv::Rect    dst;        ///< output pixels
+        cv::Rect    src;        ///< raw window, empty if the tile maps outside the frame
+        size_t      offset;     ///< first map element of the tile
+    };
+
+    cv::Mat             _mapx;      ///< kept to rebuild for another raw size
+    cv::Mat             _mapy;
+    cv::Size            _srcSize;
+    int                 _tileSize;
+
+    std::vector<Tile>   _tiles;
+    cv::Mat             _map1;      ///< CV_16SC2, tile after tile
+    cv::Mat             _map2;      ///< CV_16UC1, tile after tile
+
+    cv::Rect footprint(const cv::Rect &tile) const;
+    void build(cv::Size srcSize);
+
+    friend class TiledRemapBody;
+
+public:
+
+    TiledRemap();
+
+    /** Floating point maps (CV_32FC1) from output to raw frame coordinates */
+    void setMaps(const cv::Mat &mapx, const cv::Mat &mapy);
+
+    /**
+     * Demosaic raw (CV_8UC1 Bayer mosaic) with the cv::cvtColor code and
+     * remap it into dst, which is (re)allocated as CV_8UC3 of the map size.
+     */
+    void apply(const cv::Mat &raw, int code, cv::Mat &dst);
+
+    /** Edge of the square tiles in use, 0 before the first apply() */
+    int tileSize() const { return _tileSize; }
+
+    /** L2 cache size in bytes, 256 KiB if it cannot be queried */
+    static size_t cacheSize();
+};
+
+
+#endif
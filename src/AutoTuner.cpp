@@ -0,0 +1,240 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#include <iCub/AutoTuner.h>
+#include <iCub/ProcessingBackend.h>
+
+// std
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#ifdef _WIN32
+    #include <winsock2.h>
+#else
+    #include <unistd.h>
+#endif
+
+// opencv
+#include <opencv2/opencv.hpp>
+
+// yarp
+#include <yarp/os/Property.h>
+#include <yarp/os/Time.h>
+#include <yarp/sig/Image.h>
+
+using namespace std;
+using namespace yarp::os;
+using namespace yarp::sig;
+
+// FNV-1a, keys long strings into the tuning file
+static string hashString(const string &text) {
+    unsigned int h = 2166136261u;
+    for (size_t i = 0; i < text.size(); i++) {
+        h ^= (unsigned char)text[i];
+        h *= 16777619u;
+    }
+    char buf[16];
+    sprintf(buf, "%08x", h);
+    return string(buf);
+}
+
+// backend libraries (CUDA, OpenCL, parallel framework) are part of the build
+static string buildKey() {
+    return hashString(cv::getBuildInformation());
+}
+
+AutoTuner::AutoTuner(ICalibTool *tool, int width, int height, int outWidth, int outHeight) {
+    _tool = tool;
+    _width = width;
+    _height = height;
+    _outWidth = outWidth;
+    _outHeight = outHeight;
+    _frames = 20;
+    _quality = "high";
+    _fixedDemosaic = -1;
+    _fixedPrecompose = -1;
+    _fixedThreads = -1;
+    for (int b = ICalibTool::BACKEND_CUDA; b <= ICalibTool::BACKEND_CPU; b++) {
+        if (ProcessingBackend::isAvailable(b))
+            _backends.push_back(b);
+    }
+    _best.backend = tool->getBackend();
+    _best.demosaic = ICalibTool::DEMOSAIC_MHT;
+    _best.precompose = false;
+    _best.threads = cv::getNumThreads();
+    _best.seconds = -1.0;
+}
+
+void AutoTuner::setCalibration(const string &config) {
+    _calibration = hashString(config);
+}
+
+string AutoTuner::defaultFile(const string &dir) {
+    string path = dir.empty() ? string() : dir + "/";
+    char host[256];
+    if (gethostname(host, sizeof(host)) != 0)
+        return path + "camCalibTune.ini";
+    host[sizeof(host) - 1] = '\0';
+    return path + "camCalibTune_" + host + ".ini";
+}
+
+bool AutoTuner::load(const string &file) {
+    Property prop;
+    if (!prop.fromConfigFile(file.c_str()))
+        return false;
+    if (prop.find("width").asInt() != _width ||
+        prop.find("height").asInt() != _height ||
+        prop.find("outwidth").asInt() != _outWidth ||
+        prop.find("outheight").asInt() != _outHeight ||
+        string(prop.find("quality").asString().c_str()) != _quality)
+        return false;
+    // results from another OpenCV build or calibration are stale
+    if (string(prop.find("opencv").asString().c_str()) != CV_VERSION ||
+        string(prop.find("build").asString().c_str()) != buildKey() ||
+        string(prop.find("calibration").asString().c_str()) != _calibration)
+        return false;
+    // a result for a backend that is not a candidate (any more) is stale
+    int backend = prop.find("backend").asInt();
+    if (find(_backends.begin(), _backends.end(), backend) == _backends.end())
+        return false;
+    _best.backend = backend;
+    _best.demosaic = prop.find("demosaic").asInt();
+    // the algorithm behind a demosaic mode depends on backend and OpenCV build
+    if (string(prop.find("algorithm").asString().c_str()) != ProcessingBackend::demosaicName(backend, _best.demosaic))
+        return false;
+    _best.precompose = prop.find("precompose").asInt() != 0;
+    _best.threads = prop.find("threads").asInt();
+    _best.seconds = prop.find("seconds").asDouble();
+    // a result outside the explicitly configured values does not apply
+    if ((_fixedDemosaic >= 0 && _best.demosaic != _fixedDemosaic) ||
+        (_fixedPrecompose >= 0 && (_best.precompose ? 1 : 0) != _fixedPrecompose) ||
+        (_fixedThreads > 0 && _best.threads != _fixedThreads))
+        return false;
+    return true;
+}
+
+bool AutoTuner::save(const string &file) {
+    FILE *f = fopen(file.c_str(), "w");
+    if (f == NULL)
+        return false;
+    fprintf(f, "width %d\n", _width);
+    fprintf(f, "height %d\n", _height);
+    fprintf(f, "outwidth %d\n", _outWidth);
+    fprintf(f, "outheight %d\n", _outHeight);
+    fprintf(f, "quality %s\n", _quality.c_str());
+    // quoted, a version or hex digest must not be read back as a number
+    fprintf(f, "opencv \"%s\"\n", CV_VERSION);
+    fprintf(f, "build \"%s\"\n", buildKey().c_str());
+    fprintf(f, "calibration \"%s\"\n", _calibration.c_str());
+    fprintf(f, "backend %d\n", _best.backend);
+    fprintf(f, "demosaic %d\n", _best.demosaic);
+    fprintf(f, "algorithm %s\n", ProcessingBackend::demosaicName(_best.backend, _best.demosaic));
+    fprintf(f, "precompose %d\n", _best.precompose ? 1 : 0);
+    fprintf(f, "threads %d\n", _best.threads);
+    fprintf(f, "seconds %g\n", _best.seconds);
+    fclose(f);
+    return true;
+}
+
+double AutoTuner::measure(const Variant &v) {
+    ImageOf<PixelRgb> in, out;
+    in.resize(_width, _height);
+    cv::Mat inmat(cv::cvarrToMat((IplImage*)in.getIplImage()));
+    cv::randu(inmat, cv::Scalar::all(0), cv::Scalar::all(255));
+
+    _tool->setBackend(v.backend);
+    _tool->setDemosaic(v.demosaic);
+    _tool->setPrecompose(v.precompose);
+    cv::setNumThreads(v.threads);
+
+    // first frames pay map generation and allocations
+    for (int i = 0; i < 2; i++)
+        _tool->apply(in, out);
+
+    vector<double> times;
+    for (int i = 0; i < _frames; i++) {
+        double t0 = Time::now();
+        _tool->apply(in, out);
+        times.push_back(Time::now() - t0);
+    }
+    sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+void AutoTuner::run() {
+    bool fast = _quality == "fast";
+    bool resized = _outWidth != 0 && _outHeight != 0;
+
+    // explicitly configured values are the only candidates
+    vector<int> threads;
+    if (_fixedThreads > 0) {
+        threads.push_back(_fixedThreads);
+    }
+    else {
+        int cpus = cv::getNumberOfCPUs();
+        for (int n = 1; n < cpus; n *= 2)
+            threads.push_back(n);
+        threads.push_back(cpus);
+    }
+    vector<int> demosaics;
+    if (_fixedDemosaic >= 0 || !fast)
+        demosaics.push_back(_fixedDemosaic >= 0 ? _fixedDemosaic : (int)ICalibTool::DEMOSAIC_MHT);
+    else {
+        demosaics.push_back(ICalibTool::DEMOSAIC_MHT);
+        demosaics.push_back(ICalibTool::DEMOSAIC_BILINEAR);
+    }
+    vector<bool> precomposes;
+    if (_fixedPrecompose >= 0 || !fast || !resized)
+        precomposes.push_back(_fixedPrecompose > 0);
+    else {
+        precomposes.push_back(false);
+        precomposes.push_back(true);
+    }
+
+    // MHT is only implemented by CUDA, the host backends substitute it; under
+    // "high" a backend really running MHT is preferred when there is one
+    vector<int> backends = _backends;
+    bool mht = demosaics[0] == ICalibTool::DEMOSAIC_MHT;
+    if (!fast && mht && find(backends.begin(), backends.end(), (int)ICalibTool::BACKEND_CUDA) != backends.end()) {
+        backends.clear();
+        backends.push_back(ICalibTool::BACKEND_CUDA);
+    }
+    else if (!fast && mht)
+        fprintf(stdout, "autotune: no MHT capable backend, high quality uses %s demosaicing\n",
+                ProcessingBackend::demosaicName(ICalibTool::BACKEND_CPU, ICalibTool::DEMOSAIC_MHT));
+
+    _best.seconds = -1.0;
+    for (size_t b = 0; b < backends.size(); b++) {
+        for (size_t d = 0; d < demosaics.size(); d++) {
+            for (size_t p = 0; p < precomposes.size(); p++) {
+                for (size_t t = 0; t < threads.size(); t++) {
+                    Variant v;
+                    v.backend = backends[b];
+                    v.demosaic = demosaics[d];
+                    v.precompose = precomposes[p];
+                    v.threads = threads[t];
+                    v.seconds = measure(v);
+                    fprintf(stdout, "autotune: backend=%s demosaic=%s precompose=%d threads=%d median %g [s]\n",
+                            ProcessingBackend::name(v.backend), ProcessingBackend::demosaicName(v.backend, v.demosaic),
+                            v.precompose ? 1 : 0, v.threads, v.seconds);
+                    if (_best.seconds < 0 || v.seconds < _best.seconds)
+                        _best = v;
+                }
+            }
+        }
+    }
+}
+
+void AutoTuner::apply() {
+    _tool->setBackend(_best.backend);
+    _tool->setDemosaic(_best.demosaic);
+    _tool->setPrecompose(_best.precompose);
+    cv::setNumThreads(_best.threads);
+    fprintf(stdout, "autotune: using backend=%s demosaic=%s precompose=%d threads=%d (%g [s] per frame)\n",
+            ProcessingBackend::name(_best.backend), ProcessingBackend::demosaicName(_best.backend, _best.demosaic),
+            _best.precompose ? 1 : 0, _best.threads, _best.seconds);
+}
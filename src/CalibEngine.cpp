@@ -0,0 +1,444 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#include <iCub/CalibEngine.h>
+
+#include <stdio.h>
+#include <math.h>
+
+CalibEngine::CalibEngine() {
+    _backend = NULL;
+    _intrinsic = cv::Mat::eye(3, 3, CV_32F);
+    _intrinsicScaled = cv::Mat::eye(3, 3, CV_32F);
+    _distortion = cv::Mat::zeros(1, 4, CV_32F);
+    _oldImgSize = cv::Size(-1, -1);
+    _needInit = true;
+    _mapsPrecomposed = false;
+    _tracer = NULL;
+    setParams(CalibParams());
+}
+
+CalibEngine::~CalibEngine() {
+    for (size_t i = 0; i < _rois.size(); i++)
+        delete _rois[i].backend;
+    delete _backend;
+}
+
+void CalibEngine::setParams(const CalibParams &params) {
+    int backend = _params.backend;
+    _params = params;
+
+    if (_backend == NULL || params.backend != backend) {
+        if (!setBackend(params.backend)) {
+            fprintf(stdout, "====> warning: %s backend not available, using %s\n",
+                    ProcessingBackend::name(params.backend), ProcessingBackend::name(ProcessingBackend::best()));
+            setBackend(CalibParams::BACKEND_AUTO);
+        }
+    }
+
+    _intrinsic = cv::Mat::eye(3, 3, CV_32F);
+    _intrinsic.at<float>(0, 0) = (float)_params.fx;
+    _intrinsic.at<float>(0, 2) = (float)_params.cx;
+    _intrinsic.at<float>(1, 1) = (float)_params.fy;
+    _intrinsic.at<float>(1, 2) = (float)_params.cy;
+    _intrinsic.copyTo(_intrinsicScaled);
+
+    _distortion.at<float>(0, 0) = (float)_params.k1;
+    _distortion.at<float>(0, 1) = (float)_params.k2;
+    _distortion.at<float>(0, 2) = (float)_params.p1;
+    _distortion.at<float>(0, 3) = (float)_params.p2;
+
+    _colorLut.setSaturation(_params.saturation);
+    _colorLut.setWhiteBalance(_params.whiteBalance[0], _params.whiteBalance[1], _params.whiteBalance[2]);
+    _colorLut.setColorMatrix(_params.colorMatrix);
+    _colorLut.setGamma(_params.gamma);
+
+    _needInit = true;
+}
+
+void CalibEngine::setSaturation(double satVal) {
+    _params.saturation = satVal;
+    _colorLut.setSaturation(satVal);
+}
+
+void CalibEngine::setOutputSize(int w, int h) {
+    if (w != _params.outputWidth || h != _params.outputHeight)
+        _needInit = true;
+    _params.outputWidth = w;
+    _params.outputHeight = h;
+}
+
+void CalibEngine::setSharpen(double amount) {
+    _params.sharpen = amount;
+}
+
+void CalibEngine::setWhiteBalance(double r, double g, double b) {
+    _params.whiteBalance[0] = r;
+    _params.whiteBalance[1] = g;
+    _params.whiteBalance[2] = b;
+    _colorLut.setWhiteBalance(r, g, b);
+}
+
+void CalibEngine::setColorMatrix(const double *m) {
+    for (int i = 0; i < 9; i++)
+        _params.colorMatrix[i] = m[i];
+    _colorLut.setColorMatrix(m);
+}
+
+void CalibEngine::setGamma(double gamma) {
+    _params.gamma = gamma;
+    _colorLut.setGamma(gamma);
+}
+
+void CalibEngine::setDemosaic(int mode) {
+    _params.demosaic = mode;
+}
+
+void CalibEngine::setPrecompose(bool on) {
+    if (on != _params.precompose)
+        _needInit = true;
+    _params.precompose = on;
+}
+
+bool CalibEngine::setBackend(int backend) {
+    ProcessingBackend *created = ProcessingBackend::create(backend);
+    if (created == NULL)
+        return false;
+    delete _backend;
+    _backend = created;
+    _params.backend = backend;
+    // maps live on the device of the backend
+    _needInit = true;
+    return true;
+}
+
+void CalibEngine::getOutputSize(int inWidth, int inHeight, int &outWidth, int &outHeight) const {
+    if (_params.outputWidth != 0 && _params.outputHeight != 0) {
+        outWidth = _params.outputWidth;
+        outHeight = _params.outputHeight;
+    }
+    else {
+        outWidth = inWidth;
+        outHeight = inHeight;
+    }
+}
+
+bool CalibEngine::init(cv::Size currImgSize) {
+
+    // Scale the intrinsics if required:
+    // if current image size is not the same as the size for
+    // which calibration parameters are specified we need to
+    // scale the intrinsic matrix components.
+    float scaleX = (float)currImgSize.width / (float)_params.calibWidth;
+    float scaleY = (float)currImgSize.height / (float)_params.calibHeight;
+    _intrinsic.copyTo(_intrinsicScaled);
+    _intrinsicScaled.at<float>(0, 0) *= scaleX;
+    _intrinsicScaled.at<float>(0, 2) *= scaleX;
+    _intrinsicScaled.at<float>(1, 1) *= scaleY;
+    _intrinsicScaled.at<float>(1, 2) *= scaleY;
+
+    /* init the undistortion matrices */
+    cv::initUndistortRectifyMap(_intrinsicScaled, _distortion, cv::Mat(), _intrinsicScaled,
+                                currImgSize, CV_32FC1, _mapUndistortX, _mapUndistortY);
+
+    // optionally fold the output resize into the maps so process() needs a single remap
+    _mapsPrecomposed = _params.precompose && _params.outputWidth != 0 && _params.outputHeight != 0;
+    if (_mapsPrecomposed) {
+        cv::Mat mapx, mapy;
+        cv::resize(_mapUndistortX, mapx, cv::Size(_params.outputWidth, _params.outputHeight), 0, 0, cv::INTER_LINEAR);
+        cv::resize(_mapUndistortY, mapy, cv::Size(_params.outputWidth, _params.outputHeight), 0, 0, cv::INTER_LINEAR);
+        _backend->setMaps(mapx, mapy);
+    } else {
+        _backend->setMaps(_mapUndistortX, _mapUndistortY);
+    }
+
+    // regions of interest read from the new maps
+    for (size_t i = 0; i < _rois.size(); i++)
+        _rois[i].dirty = true;
+
+    _oldImgSize = currImgSize;
+    _needInit = false;
+    return true;
+}
+
+void CalibEngine::drawCenterCross(cv::Mat &img) {
+    // painting crosshair at calibration center
+    if (_params.drawCenterCross) {
+        int cx = (int)_intrinsicScaled.at<float>(0, 2);
+        int cy = (int)_intrinsicScaled.at<float>(1, 2);
+        cv::line(img, cv::Point(cx - 10, cy), cv::Point(cx + 10, cy), cv::Scalar::all(255));
+        cv::line(img, cv::Point(cx, cy - 10), cv::Point(cx, cy + 10), cv::Scalar::all(255));
+    }
+}
+
+bool CalibEngine::colorOnDevice(ProcessingBackend *backend) {
+    cv::Mat table;
+    double saturation;
+    return _colorLut.getChannelStages(table, saturation) && backend->color(table, saturation);
+}
+
+void CalibEngine::sharpenHost(cv::Mat &img) {
+    // same unsharp mask as the backends, on the color processed frame
+    cv::GaussianBlur(img, _sharpenBlur, cv::Size(5, 5), 5);
+    cv::addWeighted(img, 1.0 + _params.sharpen, _sharpenBlur, -_params.sharpen, 0, img);
+}
+
+bool CalibEngine::process(const ImageView &in, const ImageView &out) {
+    return process(in, &out, 1);
+}
+
+bool CalibEngine::process(const ImageView &in, const ImageView *outs, int count) {
+
+    int outWidth, outHeight;
+    getOutputSize(in.width, in.height, outWidth, outHeight);
+    const ImageView *rgbOut = NULL;
+    int converted = 0;
+    for (int i = 0; i < count; i++) {
+        if (outs[i].width != outWidth || outs[i].height != outHeight)
+            return false;
+        if (outs[i].format == ImageView::FORMAT_RGB8) {
+            rgbOut = &outs[i];
+            continue;
+        }
+        if (outs[i].format != ImageView::FORMAT_MONO8 && ((outWidth & 1) || (outHeight & 1)))
+            return false;
+        converted++;
+    }
+
+    cv::Size inSize(in.width, in.height);
+
+    // check if reallocation required
+    if (inSize != _oldImgSize || _needInit) {
+        if (_tracer) _tracer->beginStage("init");
+        init(inSize);
+        if (_tracer) _tracer->endStage();
+    }
+
+    cv::Mat inmat(in.height, in.width, in.channels() == 1 ? CV_8UC1 : CV_8UC3, in.data, in.stride);
+
+    if (_tracer) _tracer->beginStage("upload");
+    _backend->upload(inmat);
+    if (_tracer) _tracer->endStage();
+    if (_tracer) _tracer->beginStage("demosaic");
+    _backend->demosaic(_params.demosaic);
+    if (_tracer) _tracer->endStage();
+    if (_tracer) _tracer->beginStage("remap");
+    if (_params.outputWidth != 0 && _params.outputHeight != 0 && !_mapsPrecomposed)
+        _backend->remap(cv::Size(_params.outputWidth, _params.outputHeight));
+    else
+        _backend->remap(cv::Size());
+    if (_tracer) _tracer->endStage();
+
+    // color processing goes before sharpening, as it always did: on the
+    // device when the backend can, else on the host after download with
+    // the sharpening following it there
+    bool hostColor = false;
+    if (!_colorLut.isIdentity()) {
+        if (_tracer) _tracer->beginStage("color");
+        hostColor = !colorOnDevice(_backend);
+        if (_tracer) _tracer->endStage();
+    }
+    bool hostSharpen = _params.sharpen != 0 && hostColor;
+    if (_params.sharpen != 0 && !hostSharpen) {
+        if (_tracer) _tracer->beginStage("sharpen");
+        _backend->sharpen(_params.sharpen);
+        if (_tracer) _tracer->endStage();
+    }
+
+    // RGB is downloaded and color processed in place, the other formats are
+    // converted from it in the same pass that applies the color LUT
+    cv::Mat rgb;
+    bool rgbColored = false;
+    if (rgbOut != NULL) {
+        if (_tracer) _tracer->beginStage("download");
+        rgb = cv::Mat(rgbOut->height, rgbOut->width, CV_8UC3, rgbOut->data, rgbOut->stride);
+        _backend->download(rgb);
+        if (_tracer) _tracer->endStage();
+
+        // white balance, color matrix, gamma and saturation in one pass
+        if (hostColor) {
+            if (_tracer) _tracer->beginStage("color");
+            _colorLut.apply(rgb);
+            if (_tracer) _tracer->endStage();
+        }
+        if (hostSharpen) {
+            if (_tracer) _tracer->beginStage("sharpen");
+            sharpenHost(rgb);
+            if (_tracer) _tracer->endStage();
+        }
+        drawCenterCross(rgb);
+        rgbColored = true;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const ImageView &out = outs[i];
+        if (out.format == ImageView::FORMAT_RGB8)
+            continue;
+
+        if (out.format == ImageView::FORMAT_MONO8 && rgb.empty() && !hostColor) {
+            // luma on the device, a third of the bytes cross the bus
+            if (_tracer) _tracer->beginStage("download");
+            cv::Mat mono(out.height, out.width, CV_8UC1, out.data, out.stride);
+            _backend->downloadGray(mono);
+            if (_tracer) _tracer->endStage();
+            drawCenterCross(mono);
+            continue;
+        }
+
+        if (rgb.empty()) {
+            if (_tracer) _tracer->beginStage("download");
+            _hostRgb.create(outHeight, outWidth, CV_8UC3);
+            _backend->download(_hostRgb);
+            if (_tracer) _tracer->endStage();
+            rgb = _hostRgb;
+            rgbColored = !hostColor;
+            // sharpening and the cross go on after color processing, as on
+            // the RGB output, and several outputs share one LUT pass; the
+            // LUT then runs in place instead of fused into the conversion
+            if ((_params.drawCenterCross || hostSharpen || converted > 1) && hostColor) {
+                if (_tracer) _tracer->beginStage("color");
+                _colorLut.apply(rgb);
+                if (_tracer) _tracer->endStage();
+                rgbColored = true;
+            }
+            if (hostSharpen) {
+                if (_tracer) _tracer->beginStage("sharpen");
+                sharpenHost(rgb);
+                if (_tracer) _tracer->endStage();
+            }
+            drawCenterCross(rgb);
+        }
+
+        if (_tracer) _tracer->beginStage("convert");
+        if (!rgbColored)
+            _colorLut.prepare();
+        bool ok = OutputConverter::convert(rgb, out, rgbColored ? NULL : &_colorLut);
+        if (_tracer) _tracer->endStage();
+        if (!ok)
+            return false;
+    }
+
+    return true;
+}
+
+CalibEngine::RoiSlot *CalibEngine::findRoi(int id) {
+    for (size_t i = 0; i < _rois.size(); i++) {
+        if (_rois[i].id == id)
+            return &_rois[i];
+    }
+    return NULL;
+}
+
+void CalibEngine::setRoi(int id, int x, int y, int w, int h) {
+    RoiSlot *slot = findRoi(id);
+    if (slot == NULL) {
+        RoiSlot added;
+        added.id = id;
+        added.backend = NULL;
+        _rois.push_back(added);
+        slot = &_rois.back();
+    }
+    slot->rect = cv::Rect(x, y, w > 1 ? w : 1, h > 1 ? h : 1);
+    slot->dirty = true;
+}
+
+void CalibEngine::removeRoi(int id) {
+    for (size_t i = 0; i < _rois.size(); i++) {
+        if (_rois[i].id == id) {
+            delete _rois[i].backend;
+            _rois.erase(_rois.begin() + i);
+            return;
+        }
+    }
+}
+
+bool CalibEngine::getRoiSize(int id, int inWidth, int inHeight, int &width, int &height) const {
+    for (size_t i = 0; i < _rois.size(); i++) {
+        if (_rois[i].id == id) {
+            width = std::min(_rois[i].rect.width, inWidth);
+            height = std::min(_rois[i].rect.height, inHeight);
+            return true;
+        }
+    }
+    return false;
+}
+
+void CalibEngine::prepareRoi(RoiSlot &slot, cv::Size inSize) {
+    if (slot.backend == NULL || slot.backend->kind() != _backend->kind()) {
+        delete slot.backend;
+        slot.backend = ProcessingBackend::create(_backend->kind());
+    }
+
+    // keep the crop size, move it inside the image
+    int w = std::min(slot.rect.width, inSize.width);
+    int h = std::min(slot.rect.height, inSize.height);
+    int x = std::max(0, std::min(slot.rect.x, inSize.width - w));
+    int y = std::max(0, std::min(slot.rect.y, inSize.height - h));
+    slot.dst = cv::Rect(x, y, w, h);
+
+    // raw bounding box of the sub-maps plus a margin for demosaicing and
+    // interpolation, started on even coordinates to keep the Bayer phase
+    cv::Mat mapx = _mapUndistortX(slot.dst);
+    cv::Mat mapy = _mapUndistortY(slot.dst);
+    double minX, maxX, minY, maxY;
+    cv::minMaxLoc(mapx, &minX, &maxX);
+    cv::minMaxLoc(mapy, &minY, &maxY);
+    const int margin = 3;
+    int x0 = std::max(0, (int)floor(minX) - margin) & ~1;
+    int y0 = std::max(0, (int)floor(minY) - margin) & ~1;
+    int x1 = std::min(inSize.width, (int)ceil(maxX) + margin + 1);
+    int y1 = std::min(inSize.height, (int)ceil(maxY) + margin + 1);
+    if (x1 - x0 < 2 || y1 - y0 < 2)
+        slot.src = cv::Rect(0, 0, inSize.width, inSize.height);     // maps entirely outside the image
+    else
+        slot.src = cv::Rect(x0, y0, x1 - x0, y1 - y0);
+
+    cv::Mat shiftedX, shiftedY;
+    cv::subtract(mapx, cv::Scalar((double)slot.src.x), shiftedX);
+    cv::subtract(mapy, cv::Scalar((double)slot.src.y), shiftedY);
+    slot.backend->setMaps(shiftedX, shiftedY);
+    slot.dirty = false;
+}
+
+bool CalibEngine::processRoi(const ImageView &in, int id, const ImageView &out) {
+    RoiSlot *slot = findRoi(id);
+    int w, h;
+    if (slot == NULL || !getRoiSize(id, in.width, in.height, w, h))
+        return false;
+    if (out.format != ImageView::FORMAT_RGB8 || out.width != w || out.height != h)
+        return false;
+
+    cv::Size inSize(in.width, in.height);
+    if (inSize != _oldImgSize || _needInit) {
+        if (_tracer) _tracer->beginStage("init");
+        init(inSize);
+        if (_tracer) _tracer->endStage();
+    }
+
+    if (_tracer) _tracer->beginStage("roi");
+    if (slot->dirty)
+        prepareRoi(*slot, inSize);
+
+    cv::Mat inmat(in.height, in.width, in.channels() == 1 ? CV_8UC1 : CV_8UC3, in.data, in.stride);
+    ProcessingBackend *backend = slot->backend;
+    backend->upload(inmat(slot->src));
+    backend->demosaic(_params.demosaic);
+    backend->remap(cv::Size());
+    bool hostColor = !_colorLut.isIdentity() && !colorOnDevice(backend);
+    if (_params.sharpen != 0 && !hostColor)
+        backend->sharpen(_params.sharpen);
+    cv::Mat outmat(out.height, out.width, CV_8UC3, out.data, out.stride);
+    backend->download(outmat);
+    if (hostColor) {
+        _colorLut.apply(outmat);
+        if (_params.sharpen != 0)
+            sharpenHost(outmat);
+    }
+    if (_tracer) _tracer->endStage();
+
+    return true;
+}
@@ -0,0 +1,141 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#include <iCub/CalibToolGroup.h>
+
+using namespace yarp::os;
+using namespace yarp::sig;
+
+CalibToolGroup::CalibToolGroup() {
+    _roiTool = NULL;
+}
+
+CalibToolGroup::~CalibToolGroup() {
+    for (size_t i = 0; i < _tools.size(); i++)
+        delete _tools[i];
+    _tools.clear();
+    _roiTool = NULL;
+}
+
+void CalibToolGroup::add(ICalibTool *tool) {
+    _tools.push_back(tool);
+}
+
+void CalibToolGroup::addRoiTool(ICalibTool *tool) {
+    _tools.push_back(tool);
+    _roiTool = tool;
+}
+
+bool CalibToolGroup::open(Searchable &config) {
+    bool ok = true;
+    for (size_t i = 0; i < _tools.size(); i++)
+        ok = _tools[i]->open(config) && ok;
+    return ok;
+}
+
+bool CalibToolGroup::close() {
+    bool ok = true;
+    for (size_t i = 0; i < _tools.size(); i++)
+        ok = _tools[i]->close() && ok;
+    return ok;
+}
+
+bool CalibToolGroup::configure(Searchable &config) {
+    bool ok = true;
+    for (size_t i = 0; i < _tools.size(); i++)
+        ok = _tools[i]->configure(config) && ok;
+    return ok;
+}
+
+void CalibToolGroup::apply(const ImageOf<PixelRgb> &in, ImageOf<PixelRgb> &out) {
+    if (!_tools.empty())
+        _tools[0]->apply(in, out);
+}
+
+bool CalibToolGroup::apply(const ImageOf<PixelRgb> &in, CalibOutputs &outs) {
+    return !_tools.empty() && _tools[0]->apply(in, outs);
+}
+
+void CalibToolGroup::setSaturation(double satVal) {
+    for (size_t i = 0; i < _tools.size(); i++)
+        _tools[i]->setSaturation(satVal);
+}
+
+void CalibToolGroup::setOutputWidth(int w) {
+    for (size_t i = 0; i < _tools.size(); i++)
+        _tools[i]->setOutputWidth(w);
+}
+
+void CalibToolGroup::setOutputHeight(int h) {
+    for (size_t i = 0; i < _tools.size(); i++)
+        _tools[i]->setOutputHeight(h);
+}
+
+void CalibToolGroup::setOutputSize(int w, int h) {
+    for (size_t i = 0; i < _tools.size(); i++)
+        _tools[i]->setOutputSize(w, h);
+}
+
+void CalibToolGroup::setSharpen(double amount) {
+    for (size_t i = 0; i < _tools.size(); i++)
+        _tools[i]->setSharpen(amount);
+}
+
+void CalibToolGroup::setWhiteBalance(double r, double g, double b) {
+    for (size_t i = 0; i < _tools.size(); i++)
+        _tools[i]->setWhiteBalance(r, g, b);
+}
+
+void CalibToolGroup::setColorMatrix(const double *m) {
+    for (size_t i = 0; i < _tools.size(); i++)
+        _tools[i]->setColorMatrix(m);
+}
+
+void CalibToolGroup::setGamma(double gamma) {
+    for (size_t i = 0; i < _tools.size(); i++)
+        _tools[i]->setGamma(gamma);
+}
+
+void CalibToolGroup::setDemosaic(int mode) {
+    for (size_t i = 0; i < _tools.size(); i++)
+        _tools[i]->setDemosaic(mode);
+}
+
+void CalibToolGroup::setPrecompose(bool on) {
+    for (size_t i = 0; i < _tools.size(); i++)
+        _tools[i]->setPrecompose(on);
+}
+
+bool CalibToolGroup::setBackend(int backend) {
+    bool ok = true;
+    for (size_t i = 0; i < _tools.size(); i++)
+        ok = _tools[i]->setBackend(backend) && ok;
+    return ok;
+}
+
+int CalibToolGroup::getBackend() {
+    return _tools.empty() ? (int)BACKEND_AUTO : _tools[0]->getBackend();
+}
+
+void CalibToolGroup::setRoi(int id, int x, int y, int w, int h) {
+    if (_roiTool != NULL)
+        _roiTool->setRoi(id, x, y, w, h);
+}
+
+void CalibToolGroup::removeRoi(int id) {
+    if (_roiTool != NULL)
+        _roiTool->removeRoi(id);
+}
+
+bool CalibToolGroup::applyRoi(int id, const ImageOf<PixelRgb> &in, ImageOf<PixelRgb> &out) {
+    return _roiTool != NULL && _roiTool->applyRoi(id, in, out);
+}
+
+void CalibToolGroup::setTracer(FrameTracer *) {
+    for (size_t i = 0; i < _tools.size(); i++)
+        _tools[i]->setTracer(NULL);
+}
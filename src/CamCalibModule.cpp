@@ -7,15 +7,33 @@
  */
 
 #include <iCub/CamCalibModule.h>
+#include <iCub/AutoTuner.h>
+#include <iCub/CalibToolGroup.h>
+#include <iCub/ProcessingBackend.h>
 
 using namespace std;
 using namespace yarp::os;
 using namespace yarp::sig;
 
-CamCalibPort::CamCalibPort()
+CamCalibPort::CamCalibPort() : warmMutex(1)
 {
     portImgOut=NULL;
+    portMono=NULL;
+    portNv12=NULL;
+    portI420=NULL;
     calibTool=NULL;
+    tracer=NULL;
+    portCompressed=NULL;
+    encoder=NULL;
+    pipeline=NULL;
+    recorder=NULL;
+    quality=NULL;
+    rois=NULL;
+    placed=true;
+    warmFrame=NULL;
+    warmFrames=0;
+    warmFirst=0.0;
+    lastPublish=0.0;
 
     verbose=false;
     t0=Time::now();
@@ -27,13 +45,95 @@ void CamCalibPort::setPointers(yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::s
     calibTool=_calibTool;
 }
 
+void CamCalibPort::setFormatPorts(yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelMono> > *_portMono,
+                                  yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelMono> > *_portNv12,
+                                  yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelMono> > *_portI420)
+{
+    portMono=_portMono;
+    portNv12=_portNv12;
+    portI420=_portI420;
+}
+
+void CamCalibPort::prepareOutputs(CalibOutputs &outs)
+{
+    outs.rgb = portImgOut!=NULL ? &portImgOut->prepare() : NULL;
+    outs.mono = portMono!=NULL ? &portMono->prepare() : NULL;
+    outs.nv12 = portNv12!=NULL ? &portNv12->prepare() : NULL;
+    outs.i420 = portI420!=NULL ? &portI420->prepare() : NULL;
+}
+
+void CamCalibPort::unprepareOutputs()
+{
+    if (portImgOut!=NULL)
+        portImgOut->unprepare();
+    if (portMono!=NULL)
+        portMono->unprepare();
+    if (portNv12!=NULL)
+        portNv12->unprepare();
+    if (portI420!=NULL)
+        portI420->unprepare();
+}
+
+void CamCalibPort::beforeApply(ICalibTool *tool)
+{
+    // quality level changes reach each worker's tool between its frames
+    if (quality!=NULL)
+        quality->sync(tool);
+}
+
+void CamCalibPort::setCompressed(yarp::os::BufferedPort<yarp::os::Bottle> *_portCompressed, JpegSliceEncoder *_encoder)
+{
+    portCompressed=_portCompressed;
+    encoder=_encoder;
+}
+
 void CamCalibPort::onRead(ImageOf<PixelRgb> &yrpImgIn)
 {
     double t=Time::now();
+
+    yarp::os::Stamp stamp;
+    BufferedPort<ImageOf<PixelRgb> >::getEnvelope(stamp);
+
+    if (recorder!=NULL)
+        recorder->push(yrpImgIn,stamp,t);
+
+    process(yrpImgIn,stamp,t);
+}
+
+void CamCalibPort::process(const ImageOf<PixelRgb> &yrpImgIn, yarp::os::Stamp &stamp, double t)
+{
+    // receive and processing share the callback thread; the warm-up ran on a
+    // thread with the same placement, so buffers are local to it either way
+    if (!placed)
+    {
+        placement.apply("processing");
+        placed=true;
+    }
+
+    if (quality!=NULL)
+        quality->setInputSize(yrpImgIn.width(),yrpImgIn.height());
+
+    // parallel workers, published in order by the pipeline's thread
+    if (pipeline!=NULL)
+    {
+        pipeline->push(yrpImgIn,stamp,t);
+        if (rois!=NULL)
+        {
+            beforeApply(rois->getTool());
+            rois->process(yrpImgIn,stamp);
+        }
+        t0=t;
+        return;
+    }
+
+    if (tracer!=NULL)
+        tracer->beginFrame(stamp.isValid() ? stamp.getTime() : -1.0, t);
+
     // execute calibration
-    if (portImgOut!=NULL)
+    if (hasOutputs())
     {        
-        yarp::sig::ImageOf<PixelRgb> &yrpImgOut=portImgOut->prepare();
+        CalibOutputs outs;
+        prepareOutputs(outs);
 
         if (verbose)
             fprintf(stdout,"received input image after %g [s] ... ",t-t0);
@@ -42,33 +142,259 @@ void CamCalibPort::onRead(ImageOf<PixelRgb> &yrpImgIn)
 
         if (calibTool!=NULL)
         {
-            calibTool->apply(yrpImgIn,yrpImgOut);
+            beforeApply(calibTool);
+            if (!calibTool->apply(yrpImgIn,outs))
+            {
+                // nothing valid to publish for this frame
+                unprepareOutputs();
+                t0=t;
+                return;
+            }
+            if (quality!=NULL)
+                quality->update(Time::now()-t1);
 
         if (verbose)
                 fprintf(stdout,"calibrated in %g [s]\n",Time::now()-t1);
         }
         else
         {
-            yrpImgOut=yrpImgIn;
+            // no conversion without a tool, only rgb and mono are passed on
+            if (outs.rgb!=NULL)
+                *outs.rgb=yrpImgIn;
+            if (outs.mono!=NULL)
+                outs.mono->copy(yrpImgIn);
+            outs.nv12=NULL;
+            outs.i420=NULL;
 
             if (verbose)
                 fprintf(stdout,"just copied in %g [s]\n",Time::now()-t1);
         }
 
-        //timestamp propagation
-        yarp::os::Stamp stamp;
-        BufferedPort<ImageOf<PixelRgb> >::getEnvelope(stamp);
-        portImgOut->setEnvelope(stamp);
-
-        portImgOut->writeStrict();
+        writeOutput(outs,stamp);
     }
 
+    // crops after the main output, they do not add to its latency
+    if (rois!=NULL && calibTool!=NULL)
+        rois->process(yrpImgIn,stamp);
+
     t0=t;
 }
 
+// copied frames sent before the next one that bring a port back to zero copy
+static const int KEEP_UP_FRAMES=30;
+
+// Points the next buffer of port at img instead of copying it, img must then
+// stay untouched until releaseOutput(). Ports whose readers fell behind get
+// a copy instead, so the slot does not wait for them
+template <class T>
+ImageOf<T> *CamCalibPort::wrapOutput(BufferedPort<ImageOf<T> > *port, ImageOf<T> &img, OutputMode &mode)
+{
+    if (mode.copy)
+    {
+        mode.keptUp=port->isWriting() ? 0 : mode.keptUp+1;
+        if (mode.keptUp>=KEEP_UP_FRAMES)
+            mode.copy=false;
+    }
+    ImageOf<T> &out=port->prepare();
+    if (mode.copy)
+    {
+        // detach from a slot buffer of an earlier zero copy frame first
+        out.resize(0,0);
+        out.copy(img);
+    }
+    else
+    {
+        out.setQuantum(img.getQuantum());
+        out.setExternal(img.getRawImage(),img.width(),img.height());
+    }
+    return &out;
+}
+
+// Waits until a zero copy write no longer reads the slot; a wait longer than
+// budget switches the port to copies
+template <class T>
+void CamCalibPort::releaseOutput(BufferedPort<ImageOf<T> > *port, OutputMode &mode, double budget)
+{
+    if (mode.copy)
+        return;
+    double t=Time::now();
+    port->waitForWrite();
+    if (budget>0 && Time::now()-t>budget)
+    {
+        mode.copy=true;
+        mode.keptUp=0;
+    }
+}
+
+// copies are written non-strict: a reader still busy with the previous
+// frame misses this one instead of holding up the others
+template <class T>
+void CamCalibPort::writePort(BufferedPort<ImageOf<T> > *port, const OutputMode &mode, Stamp &stamp)
+{
+    port->setEnvelope(stamp);
+    if (mode.copy)
+        port->write();
+    else
+        port->writeStrict();
+}
+
+void CamCalibPort::publish(CalibOutputs &outs, yarp::os::Stamp &stamp,
+                           double receive, double start, double end)
+{
+    if (!hasOutputs())
+        return;
+
+    if (tracer!=NULL)
+    {
+        tracer->beginFrame(stamp.isValid() ? stamp.getTime() : -1.0, receive);
+        tracer->addStage("process", start, end);
+    }
+    if (quality!=NULL)
+        quality->update(end-start);
+    // the ports send straight from the slot buffers while their readers keep up
+    CalibOutputs portOuts;
+    if (portImgOut!=NULL && outs.rgb!=NULL)
+        portOuts.rgb=wrapOutput(portImgOut,*outs.rgb,modeRgb);
+    if (portMono!=NULL && outs.mono!=NULL)
+        portOuts.mono=wrapOutput(portMono,*outs.mono,modeMono);
+    if (portNv12!=NULL && outs.nv12!=NULL)
+        portOuts.nv12=wrapOutput(portNv12,*outs.nv12,modeNv12);
+    if (portI420!=NULL && outs.i420!=NULL)
+        portOuts.i420=wrapOutput(portI420,*outs.i420,modeI420);
+
+    if (verbose)
+        fprintf(stdout,"published frame received %g [s] ago, calibrated in %g [s]\n",Time::now()-receive,end-start);
+
+    writeOutput(portOuts,stamp);
+
+    // the slot is reused once this returns; a port that held it for more
+    // than half a frame interval is copied from the next frame on, so a
+    // reader falling behind stalls the publisher for one frame only
+    double now=Time::now();
+    double budget=lastPublish>0 ? 0.5*(now-lastPublish) : 0.0;
+    lastPublish=now;
+    if (portOuts.rgb!=NULL)
+        releaseOutput(portImgOut,modeRgb,budget);
+    if (portOuts.mono!=NULL)
+        releaseOutput(portMono,modeMono,budget);
+    if (portOuts.nv12!=NULL)
+        releaseOutput(portNv12,modeNv12,budget);
+    if (portOuts.i420!=NULL)
+        releaseOutput(portI420,modeI420,budget);
+}
+
+void CamCalibPort::writeOutput(CalibOutputs &outs, yarp::os::Stamp &stamp)
+{
+    if (tracer!=NULL)
+        tracer->beginStage("publish");
+    //timestamp propagation
+    if (outs.rgb!=NULL)
+        writePort(portImgOut,modeRgb,stamp);
+    if (outs.mono!=NULL)
+        writePort(portMono,modeMono,stamp);
+    if (outs.nv12!=NULL)
+        writePort(portNv12,modeNv12,stamp);
+    if (outs.i420!=NULL)
+        writePort(portI420,modeI420,stamp);
+    double tPublish=Time::now();
+    if (tracer!=NULL)
+        tracer->endStage();
+
+    // compressed copy for remote consumers, encoded straight from the
+    // buffer just published and only if somebody is listening
+    if (portCompressed!=NULL && outs.rgb!=NULL && portCompressed->getOutputCount()>0)
+    {
+        if (tracer!=NULL)
+            tracer->beginStage("encode");
+        cv::Mat outmat(cv::cvarrToMat((IplImage*)outs.rgb->getIplImage()));
+        encoder->encode(outmat, portCompressed->prepare());
+        portCompressed->setEnvelope(stamp);
+        portCompressed->write();
+        if (tracer!=NULL)
+            tracer->endStage();
+    }
+
+    if (tracer!=NULL)
+        tracer->endFrame(tPublish);
+}
+
+void CamCalibPort::setWarmUp(const ImageOf<PixelRgb> *frame, int frames)
+{
+    warmFrame=frame;
+    warmFrames=frames;
+    warmFirst=0.0;
+}
+
+double CamCalibPort::getWarmUpFirst()
+{
+    warmMutex.wait();
+    double first=warmFirst;
+    warmMutex.post();
+    return first;
+}
+
+void CamCalibPort::warmUp(ICalibTool *tool)
+{
+    // synthetic frames so maps, device context, buffers and filters exist
+    // before the first real frame, allocated on the calling (placed) thread
+    if (warmFrame==NULL || tool==NULL)
+        return;
+    ImageOf<PixelRgb> outRgb;
+    ImageOf<PixelMono> outMono, outNv12, outI420;
+    CalibOutputs outs;
+    outs.rgb = portImgOut!=NULL ? &outRgb : NULL;
+    outs.mono = portMono!=NULL ? &outMono : NULL;
+    outs.nv12 = portNv12!=NULL ? &outNv12 : NULL;
+    outs.i420 = portI420!=NULL ? &outI420 : NULL;
+    double first=0.0;
+    for (int i=0; i<warmFrames; i++)
+    {
+        double t=Time::now();
+        tool->apply(*warmFrame,outs);
+        if (i==0)
+            first=Time::now()-t;
+    }
+    warmMutex.wait();
+    if (first>warmFirst)
+        warmFirst=first;
+    warmMutex.post();
+}
+
+namespace {
+
+// warm-up of a tool not driven by a pipeline worker
+class WarmUpJob : public PlacedJob
+{
+private:
+    CamCalibPort    &port;
+    ICalibTool      *tool;
+public:
+    WarmUpJob(const ThreadPlacement &placement, const char *what, CamCalibPort &_port, ICalibTool *_tool) :
+        PlacedJob(placement, what), port(_port), tool(_tool) {}
+    virtual void job() { port.warmUp(tool); }
+};
+
+// the tuner's frames allocate the buffers the processing thread keeps
+class AutoTuneJob : public PlacedJob
+{
+private:
+    AutoTuner       &tuner;
+public:
+    AutoTuneJob(const ThreadPlacement &placement, AutoTuner &_tuner) :
+        PlacedJob(placement, "autotune"), tuner(_tuner) {}
+    virtual void job() { tuner.run(); }
+};
+
+}
+
 CamCalibModule::CamCalibModule(){
 
     _calibTool = NULL;	
+    _tracer = NULL;
+    _pipeline = NULL;
+    _recorder = NULL;
+    _replay = NULL;
+    _quality = NULL;
 }
 
 CamCalibModule::~CamCalibModule(){
@@ -118,6 +444,40 @@ bool CamCalibModule::configure(yarp::os::ResourceFinder &rf){
         }
     }
 
+    // identical tools for frames processed concurrently, parameter changes reach all of them
+    CalibToolGroup *toolGroup = NULL;
+    int parallelFrames = rf.check("parallelframes", Value(1), "Number of frames processed concurrently (int)").asInt();
+    if (_calibTool!=NULL && parallelFrames > 1) {
+        toolGroup = new CalibToolGroup();
+        toolGroup->add(_calibTool);
+        _calibTool = toolGroup;
+        for (int i = 1; i < parallelFrames; i++) {
+            ICalibTool *tool = CalibToolFactories::getPool().get(calibToolName.c_str());
+            if (!tool->open(botConfig)) {
+                delete tool;
+                _calibTool->close();
+                delete _calibTool;
+                _calibTool = NULL;
+                return false;
+            }
+            toolGroup->add(tool);
+        }
+    }
+    // crops are computed in the receiving thread, by a tool of their own when
+    // the others belong to the pipeline workers
+    ICalibTool *roiTool = _calibTool;
+    if (toolGroup != NULL) {
+        roiTool = CalibToolFactories::getPool().get(calibToolName.c_str());
+        if (!roiTool->open(botConfig)) {
+            delete roiTool;
+            _calibTool->close();
+            delete _calibTool;
+            _calibTool = NULL;
+            return false;
+        }
+        toolGroup->addRoiTool(roiTool);
+    }
+
     if (yarp::os::Network::exists(getName("/in")))
     {
         cout << "====> warning: port " << getName("/in") << " already in use" << endl;
@@ -131,43 +491,347 @@ bool CamCalibModule::configure(yarp::os::ResourceFinder &rf){
         cout << "====> warning: port " << getName("/conf") << " already in use" << endl;    
     }
     _calibTool->setSaturation(rf.check("saturation", Value(1.0)).asDouble());
-	_calibTool->setOutputWidth(rf.check("outwidth", Value(0)).asInt());
-	_calibTool->setOutputHeight(rf.check("outheight", Value(0)).asInt());
+	_calibTool->setOutputSize(rf.check("outwidth", Value(0)).asInt(), rf.check("outheight", Value(0)).asInt());
 	_calibTool->setSharpen(rf.check("sharpen", Value(0)).asDouble());
+    if (rf.check("whitebalance"))
+    {
+        Bottle *wb = rf.find("whitebalance").asList();
+        if (wb != NULL && wb->size() == 3)
+            _calibTool->setWhiteBalance(wb->get(0).asDouble(), wb->get(1).asDouble(), wb->get(2).asDouble());
+    }
+    if (rf.check("ccm"))
+    {
+        Bottle *ccm = rf.find("ccm").asList();
+        if (ccm != NULL && ccm->size() == 9)
+        {
+            double m[9];
+            for (int i = 0; i < 9; i++)
+                m[i] = ccm->get(i).asDouble();
+            _calibTool->setColorMatrix(m);
+        }
+    }
+    _calibTool->setGamma(rf.check("gamma", Value(1.0)).asDouble());
+    QualityController::Baseline baseline;
+    baseline.sharpen = rf.check("sharpen", Value(0)).asDouble();
+    baseline.demosaic = rf.check("demosaic", Value("mht")).asString()=="bilinear" ?
+                        ICalibTool::DEMOSAIC_BILINEAR : ICalibTool::DEMOSAIC_MHT;
+    baseline.precompose = rf.check("precompose");
+    baseline.outWidth = rf.check("outwidth", Value(0)).asInt();
+    baseline.outHeight = rf.check("outheight", Value(0)).asInt();
+    _calibTool->setDemosaic(baseline.demosaic);
+    _calibTool->setPrecompose(baseline.precompose);
+    int backend = ICalibTool::BACKEND_AUTO;
+    string backendName = rf.check("backend", Value("auto"), "Processing backend [auto|cuda|opencl|cpu] (string)").asString().c_str();
+    if (!ProcessingBackend::parse(backendName, backend))
+        cout << "====> warning: unknown backend " << backendName << ", use auto, cuda, opencl or cpu" << endl;
+    if (!_calibTool->setBackend(backend))
+    {
+        cout << "====> warning: backend " << backendName << " not available on this host" << endl;
+        backend = ICalibTool::BACKEND_AUTO;
+        _calibTool->setBackend(backend);
+    }
+    int threads = rf.check("threads", Value(0), "OpenCV worker threads, 0 = default (int)").asInt();
+    if (threads > 0)
+        cv::setNumThreads(threads);
+    ThreadPlacement procPlacement;
+    procPlacement.configure(rf, "proccores");
+
+    if (rf.check("autotune"))
+    {
+        AutoTuner tuner(_calibTool,
+                        botConfig.check("w", Value(320)).asInt(),
+                        botConfig.check("h", Value(240)).asInt(),
+                        rf.check("outwidth", Value(0)).asInt(),
+                        rf.check("outheight", Value(0)).asInt());
+        tuner.setQuality(rf.check("autotunequality", Value("high"), "Autotune quality constraint [high|fast] (string)").asString().c_str());
+        tuner.setFrames(rf.check("autotuneframes", Value(20)).asInt());
+        // an explicit backend is kept, auto lets the tuner compare all available ones
+        if (backend != ICalibTool::BACKEND_AUTO)
+            tuner.setBackends(vector<int>(1, backend));
+        // explicit options are kept, the tuner only picks what was left open
+        if (rf.check("demosaic"))
+            tuner.fixDemosaic(baseline.demosaic);
+        if (rf.check("precompose"))
+            tuner.fixPrecompose(true);
+        if (threads > 0)
+            tuner.fixThreads(threads);
+        tuner.setCalibration(botConfig.toString().c_str());
+        // per-user context directory, the working directory if there is none
+        string tuneDir = rf.getHomeContextPath().c_str();
+        if (!tuneDir.empty() && yarp::os::mkdir_p(tuneDir.c_str()) != 0)
+            tuneDir = "";
+        string tuneFile = rf.check("autotunefile", Value(AutoTuner::defaultFile(tuneDir).c_str()),
+                                   "Per-host tuning result file (string)").asString().c_str();
+        if (tuner.load(tuneFile))
+        {
+            fprintf(stdout, "autotune: loaded %s\n", tuneFile.c_str());
+        }
+        else
+        {
+            AutoTuneJob tuneJob(procPlacement, tuner);
+            tuneJob.runPlaced();
+            if (!tuner.save(tuneFile))
+                fprintf(stdout, "autotune: could not write %s\n", tuneFile.c_str());
+        }
+        tuner.apply();
+        threads = tuner.best().threads;
+        baseline.demosaic = tuner.best().demosaic;
+        baseline.precompose = tuner.best().precompose;
+    }
+
+    fprintf(stdout, "backend: %s\n", ProcessingBackend::name(_calibTool->getBackend()));
+
+    vector<int> workerCores = ThreadPlacement::parseCores(rf, "workercores");
+    if (!workerCores.empty())
+        ThreadPlacement::placeWorkerPool(workerCores, threads);
 	
-    _prtImgIn.open(getName("/in"));
-    _prtImgIn.setPointers(&_prtImgOut,_calibTool);
+    _tracer = new FrameTracer(rf.check("tracebuffer", Value(1024), "Number of frames kept for tracing (int)").asInt());
+    _tracer->setEnabled(rf.check("trace"));
+    _calibTool->setTracer(_tracer);
+
+    // one port per output format, rgb keeps the plain /out name
+    bool outRgb=false, outMono=false, outNv12=false, outI420=false;
+    Bottle formats;
+    if (rf.check("outformat"))
+    {
+        Value &v = rf.find("outformat");
+        if (v.isList())
+            formats = *v.asList();
+        else
+            formats.add(v);
+    }
+    for (int i = 0; i < formats.size(); i++)
+    {
+        ConstString f = formats.get(i).asString();
+        if (f=="rgb")
+            outRgb = true;
+        else if (f=="mono")
+            outMono = true;
+        else if (f=="nv12")
+            outNv12 = true;
+        else if (f=="i420")
+            outI420 = true;
+        else
+            cout << "====> warning: unknown output format " << f.c_str() << ", use rgb, mono, nv12 or i420" << endl;
+    }
+    if (!outRgb && !outMono && !outNv12 && !outI420)
+        outRgb = true;
+
+    _prtImgIn.setPointers(outRgb ? &_prtImgOut : NULL,_calibTool);
+    _prtImgIn.setFormatPorts(outMono ? &_prtMonoOut : NULL,
+                             outNv12 ? &_prtNv12Out : NULL,
+                             outI420 ? &_prtI420Out : NULL);
     _prtImgIn.setVerbose(rf.check("verbose"));
-    _prtImgIn.useCallback();
-    _prtImgOut.open(getName("/out"));
+    _prtImgIn.setTracer(_tracer);
+
+    // full quality is the configured (or tuned) setup, degraded under overload
+    _quality = new QualityController(baseline);
+    _quality->configure(rf, parallelFrames);
+    _prtImgIn.setQuality(_quality);
+
+    // pay for the lazy initialization now rather than on the first frame
+    int warmFrames = rf.check("warmupframes", Value(3), "Synthetic frames processed before opening /in, 0 = none (int)").asInt();
+    int expectedWidth = botConfig.check("w", Value(320)).asInt();
+    int expectedHeight = botConfig.check("h", Value(240)).asInt();
+    if (rf.check("expectedsize"))
+    {
+        string size = rf.find("expectedsize").asString().c_str();
+        if (sscanf(size.c_str(), "%dx%d", &expectedWidth, &expectedHeight) != 2 || expectedWidth <= 0 || expectedHeight <= 0)
+        {
+            cout << "====> warning: expectedsize " << size << " is not WxH, warm-up skipped" << endl;
+            warmFrames = 0;
+        }
+    }
+
+    // every tool warms up on the thread placement it will process on
+    ImageOf<PixelRgb> synthetic;
+    if (warmFrames > 0)
+    {
+        synthetic.resize(expectedWidth, expectedHeight);
+        cv::Mat synthMat(cv::cvarrToMat((IplImage*)synthetic.getIplImage()));
+        cv::randu(synthMat, cv::Scalar::all(0), cv::Scalar::all(255));
+        _prtImgIn.setWarmUp(&synthetic, warmFrames);
+    }
+    double tWarm = Time::now();
+
+    if (toolGroup != NULL)
+    {
+        // the callback only receives, workers process and a separate thread publishes
+        vector<ICalibTool*> tools;
+        for (int i = 0; i < parallelFrames; i++)
+            tools.push_back(toolGroup->get(i));
+        _pipeline = new FramePipeline(tools, &_prtImgIn,
+                                      rf.check("reorderwait", Value(0.1), "Max wait for an out of order frame [s] (double)").asDouble());
+        ThreadPlacement publishPlacement;
+        publishPlacement.configure(rf, "publishcores", "publish");
+        _pipeline->setPlacement(procPlacement, publishPlacement);
+        ThreadPlacement recvPlacement;
+        recvPlacement.configure(rf, "recvcores", "recv");
+        if (recvPlacement.isSet())
+            _prtImgIn.setPlacement(recvPlacement);
+        _prtImgIn.setPipeline(_pipeline);
+        _pipeline->setOutputs(outRgb, outMono, outNv12, outI420);
+        // workers warm up on their own threads before start() returns
+        _pipeline->start();
+        if (warmFrames > 0)
+        {
+            WarmUpJob roiWarm(recvPlacement, "recv", _prtImgIn, roiTool);
+            roiWarm.runPlaced();
+        }
+    }
+    else
+    {
+        if (procPlacement.isSet())
+            _prtImgIn.setPlacement(procPlacement);
+        if (warmFrames > 0)
+        {
+            WarmUpJob warm(procPlacement, "processing", _prtImgIn, _calibTool);
+            warm.runPlaced();
+        }
+    }
+
+    if (warmFrames > 0)
+    {
+        fprintf(stdout, "warm-up: %d frames of %dx%d on %d tool(s) in %.1f ms, first frame %.1f ms\n",
+                warmFrames, expectedWidth, expectedHeight, toolGroup != NULL ? toolGroup->size() : 1,
+                (Time::now() - tWarm) * 1000.0, _prtImgIn.getWarmUpFirst() * 1000.0);
+        _prtImgIn.setWarmUp(NULL, 0);
+    }
+
+    // foveae requested over rpc, one port each
+    _rois.setTool(roiTool);
+    _rois.setPrefix(getName("/roi/").c_str());
+    _prtImgIn.setRois(&_rois);
+
+    // raw input recording, also started and stopped over rpc
+    _recorder = new FrameRecorder(rf.check("recordqueue", Value(16), "Frames buffered for the recording writer (int)").asInt(),
+                                  rf.check("recordchunk", Value(64), "Frames per indexed chunk of a recording (int)").asInt());
+    if (rf.check("record"))
+        _recorder->record(rf.find("record").asString().c_str());
+
+    // a replayed recording replaces the input port
+    if (rf.check("replay"))
+    {
+        _replay = new FrameReplay();
+        if (!_replay->open(rf.find("replay").asString().c_str()))
+        {
+            delete _replay;
+            _replay = NULL;
+            return false;
+        }
+        _replay->setTarget(&_prtImgIn);
+        _replay->setSpeed(rf.check("replayspeed", Value(1.0), "Replay speed, 1 = recorded timing, 0 = flat out (double)").asDouble());
+        _replay->setLoop(rf.check("replayloop"));
+    }
+    else
+    {
+        _prtImgIn.setRecorder(_recorder);
+        _prtImgIn.open(getName("/in"));
+        _prtImgIn.useCallback();
+    }
+    if (outRgb)
+        _prtImgOut.open(getName("/out"));
+    if (outMono)
+        _prtMonoOut.open(getName("/out/mono"));
+    if (outNv12)
+        _prtNv12Out.open(getName("/out/nv12"));
+    if (outI420)
+        _prtI420Out.open(getName("/out/i420"));
+    if (rf.check("compressed") && !outRgb)
+    {
+        cout << "====> warning: compressed output is encoded from rgb, add rgb to outformat" << endl;
+    }
+    else if (rf.check("compressed"))
+    {
+        _encoder.setQuality(rf.check("jpegquality", Value(85), "JPEG quality of /out/compressed (int)").asInt());
+        _encoder.setSlices(rf.check("jpegslices", Value(0), "JPEG slices encoded in parallel, 0 = one per worker (int)").asInt());
+        _prtCompressed.open(getName("/out/compressed"));
+        _prtImgIn.setCompressed(&_prtCompressed, &_encoder);
+    }
     _configPort.open(getName("/conf"));
 
     attach(_configPort);
+    if (_replay != NULL)
+        _replay->start();
     fflush(stdout);
 
     return true;
 }
 
 bool CamCalibModule::close(){
+    if (_pipeline != NULL){
+        _pipeline->stop();
+    }
+    if (_replay != NULL){
+        _replay->stop();
+        delete _replay;
+        _replay = NULL;
+    }
+    if (_recorder != NULL){
+        _prtImgIn.setRecorder(NULL);
+        _recorder->stopRecording();
+    }
     _prtImgIn.close();
 	_prtImgOut.close();
+    _prtMonoOut.close();
+    _prtNv12Out.close();
+    _prtI420Out.close();
+    _prtCompressed.close();
     _configPort.close();
+    _rois.close();
+    if (_pipeline != NULL){
+        delete _pipeline;
+        _pipeline = NULL;
+    }
     if (_calibTool != NULL){
         _calibTool->close();
         delete _calibTool;
         _calibTool = NULL;
     }
+    if (_tracer != NULL){
+        delete _tracer;
+        _tracer = NULL;
+    }
+    if (_recorder != NULL){
+        delete _recorder;
+        _recorder = NULL;
+    }
+    if (_quality != NULL){
+        delete _quality;
+        _quality = NULL;
+    }
     return true;
 }
 
 bool CamCalibModule::interruptModule(){
+    // unblocks a callback waiting for a free pipeline slot
+    if (_pipeline != NULL)
+        _pipeline->stop();
+    if (_replay != NULL)
+        _replay->stop();
     _prtImgIn.interrupt();
     _prtImgOut.interrupt();
+    _prtMonoOut.interrupt();
+    _prtNv12Out.interrupt();
+    _prtI420Out.interrupt();
+    _prtCompressed.interrupt();
+    _rois.interrupt();
     _configPort.interrupt();
     return true;
 }
 
 bool CamCalibModule::updateModule(){
+    // a finished replay ends the module, e.g. for benchmark runs
+    if (_replay != NULL && _replay->isDone())
+    {
+        unsigned int fed;
+        double elapsed;
+        _replay->getProgress(fed, elapsed);
+        fprintf(stdout, "replay: %u frames in %.2f s, %.1f fps\n", fed, elapsed, elapsed > 0 ? fed / elapsed : 0.0);
+        if (_pipeline != NULL)
+            fprintf(stdout, "replay: %u frames dropped by the reorder buffer\n", _pipeline->getDropped());
+        return false;
+    }
     return true;
 }
 
@@ -188,6 +852,112 @@ bool CamCalibModule::respond(const Bottle& command, Bottle& reply) {
         _calibTool->setSaturation(satVal);
         reply.addString("ok");
     }
+    else if (command.get(0).asString()=="wb" && command.size()==4)
+    {
+        _calibTool->setWhiteBalance(command.get(1).asDouble(), command.get(2).asDouble(), command.get(3).asDouble());
+        reply.addString("ok");
+    }
+    else if (command.get(0).asString()=="ccm" && command.size()==10)
+    {
+        double m[9];
+        for (int i = 0; i < 9; i++)
+            m[i] = command.get(i+1).asDouble();
+        _calibTool->setColorMatrix(m);
+        reply.addString("ok");
+    }
+    else if (command.get(0).asString()=="trace")
+    {
+        ConstString sub = command.get(1).asString();
+        if (sub=="on" || sub=="off")
+        {
+            _tracer->setEnabled(sub=="on");
+            reply.addString("ok");
+        }
+        else if (sub=="reset")
+        {
+            _tracer->reset();
+            reply.addString("ok");
+        }
+        else if (sub=="dump" && command.size()==3)
+        {
+            if (_tracer->dump(command.get(2).asString().c_str()))
+                reply.addString("ok");
+            else
+                reply.addString("failed");
+        }
+        else
+            reply.addString("usage: trace on|off|reset|dump <file>");
+    }
+    else if (command.get(0).asString()=="latency")
+    {
+        _tracer->getStats(reply);
+        reply.addString("quality_level");
+        reply.addInt(_quality->getLevel());
+    }
+    else if (command.get(0).asString()=="quality")
+    {
+        if (command.size()==1)
+            _quality->getStats(reply);
+        else if (command.get(1).asString()=="auto")
+        {
+            _quality->setAuto();
+            reply.addString("ok");
+        }
+        else if (command.get(1).isInt() && _quality->setLevel(command.get(1).asInt()))
+            reply.addString("ok");
+        else
+            reply.addString("usage: quality [auto|<level>]");
+    }
+    else if (command.get(0).asString()=="jpegquality")
+    {
+        _encoder.setQuality(command.get(1).asInt());
+        reply.addString("ok");
+    }
+    else if (command.get(0).asString()=="record")
+    {
+        ConstString sub = command.get(1).asString();
+        if (_replay != NULL)
+            reply.addString("not available while replaying");
+        else if (command.size()==1)
+            reply.addString(_recorder->status().c_str());
+        else if (sub=="stop")
+        {
+            _recorder->stopRecording();
+            reply.addString(_recorder->status().c_str());
+        }
+        else if (_recorder->record(sub.c_str()))
+            reply.addString("ok");
+        else
+            reply.addString("failed");
+    }
+    else if (command.get(0).asString()=="roi")
+    {
+        ConstString sub = command.get(1).asString();
+        if (sub=="add" && command.size()==7)
+        {
+            if (_rois.add(command.get(2).asString().c_str(), command.get(3).asInt(), command.get(4).asInt(),
+                          command.get(5).asInt(), command.get(6).asInt()))
+                reply.addString("ok");
+            else
+                reply.addString("failed");
+        }
+        else if (sub=="del" && command.size()==3)
+        {
+            if (_rois.remove(command.get(2).asString().c_str()))
+                reply.addString("ok");
+            else
+                reply.addString("unknown roi");
+        }
+        else if (sub=="list")
+            _rois.list(reply);
+        else
+            reply.addString("usage: roi add <name> <cx> <cy> <w> <h>|del <name>|list");
+    }
+    else if (command.get(0).asString()=="gamma")
+    {
+        _calibTool->setGamma(command.get(1).asDouble());
+        reply.addString("ok");
+    }
     else
     {
         cout << "command not known - type help for more info" << endl;
@@ -0,0 +1,181 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#include <iCub/ColorLut.h>
+
+#include <math.h>
+
+namespace {
+
+class ColorLutBody : public cv::ParallelLoopBody
+{
+private:
+    cv::Mat         &img;
+    const ColorLut  &lut;
+
+public:
+    ColorLutBody(cv::Mat &_img, const ColorLut &_lut) : img(_img), lut(_lut) {
+    }
+
+    virtual void operator()(const cv::Range &range) const {
+        for (int y = range.start; y < range.end; y++) {
+            uchar *p = img.ptr<uchar>(y);
+            for (int x = 0; x < img.cols; x++, p += 3)
+                lut.lookup(p, p);
+        }
+    }
+};
+
+}
+
+ColorLut::ColorLut(int nodes) {
+    _nodes = nodes < 2 ? 2 : nodes;
+    _wb[0] = _wb[1] = _wb[2] = 1.0;
+    for (int i = 0; i < 9; i++)
+        _ccm[i] = (i % 4 == 0) ? 1.0 : 0.0;
+    _gamma = 1.0;
+    _sat = 0.0;
+    _dirty = true;
+
+    for (int v = 0; v < 256; v++) {
+        float pos = v * (_nodes - 1) / 255.0f;
+        int i = (int)pos;
+        if (i > _nodes - 2)
+            i = _nodes - 2;
+        _idx[v] = i;
+        _frac[v] = pos - i;
+    }
+}
+
+void ColorLut::setWhiteBalance(double r, double g, double b) {
+    cv::AutoLock lock(_mutex);
+    if (r != _wb[0] || g != _wb[1] || b != _wb[2]) {
+        _wb[0] = r;
+        _wb[1] = g;
+        _wb[2] = b;
+        _dirty = true;
+    }
+}
+
+void ColorLut::setColorMatrix(const double *m) {
+    cv::AutoLock lock(_mutex);
+    for (int i = 0; i < 9; i++) {
+        if (m[i] != _ccm[i]) {
+            _ccm[i] = m[i];
+            _dirty = true;
+        }
+    }
+}
+
+void ColorLut::setGamma(double g) {
+    cv::AutoLock lock(_mutex);
+    if (g > 0 && g != _gamma) {
+        _gamma = g;
+        _dirty = true;
+    }
+}
+
+void ColorLut::setSaturation(double s) {
+    cv::AutoLock lock(_mutex);
+    if (s != _sat) {
+        _sat = s;
+        _dirty = true;
+    }
+}
+
+bool ColorLut::isIdentity() {
+    cv::AutoLock lock(_mutex);
+    if (_wb[0] != 1.0 || _wb[1] != 1.0 || _wb[2] != 1.0)
+        return false;
+    for (int i = 0; i < 9; i++) {
+        if (_ccm[i] != ((i % 4 == 0) ? 1.0 : 0.0))
+            return false;
+    }
+    return _gamma == 1.0 && _sat == 0.0;
+}
+
+void ColorLut::rebuild() {
+    const int n = _nodes;
+    cv::Mat lattice(n * n * n, 1, CV_32FC3);
+
+    // white balance, color matrix and gamma in normalized RGB
+    float invGamma = (float)(1.0 / _gamma);
+    for (int r = 0; r < n; r++) {
+        for (int g = 0; g < n; g++) {
+            for (int b = 0; b < n; b++) {
+                float in[3] = { (float)(r * _wb[0] / (n - 1)),
+                                (float)(g * _wb[1] / (n - 1)),
+                                (float)(b * _wb[2] / (n - 1)) };
+                cv::Vec3f &node = lattice.at<cv::Vec3f>((r * n + g) * n + b);
+                for (int c = 0; c < 3; c++) {
+                    float v = (float)(_ccm[c * 3 + 0] * in[0] + _ccm[c * 3 + 1] * in[1] + _ccm[c * 3 + 2] * in[2]);
+                    v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+                    node[c] = (_gamma != 1.0) ? powf(v, invGamma) : v;
+                }
+            }
+        }
+    }
+
+    // saturation offset, same semantics as the former 8 bit HSV pass
+    if (_sat != 0.0) {
+        cv::cvtColor(lattice, lattice, CV_RGB2HSV);
+        float offset = (float)(_sat / 255.0);
+        for (int i = 0; i < lattice.rows; i++) {
+            float &s = lattice.at<cv::Vec3f>(i)[1];
+            s += offset;
+            s = s < 0.0f ? 0.0f : (s > 1.0f ? 1.0f : s);
+        }
+        cv::cvtColor(lattice, lattice, CV_HSV2RGB);
+    }
+
+    // the same white balance and gamma per channel, for the device backends
+    _channelTable.create(1, 256, CV_8UC3);
+    for (int v = 0; v < 256; v++) {
+        for (int c = 0; c < 3; c++) {
+            float x = (float)(v * _wb[c] / 255.0);
+            x = x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+            _channelTable.at<cv::Vec3b>(v)[c] = cv::saturate_cast<uchar>(((_gamma != 1.0) ? powf(x, invGamma) : x) * 255.0f);
+        }
+    }
+
+    _table.resize(n * n * n * 3);
+    for (int i = 0; i < n * n * n; i++) {
+        const cv::Vec3f &node = lattice.at<cv::Vec3f>(i);
+        _table[i * 3 + 0] = node[0] * 255.0f;
+        _table[i * 3 + 1] = node[1] * 255.0f;
+        _table[i * 3 + 2] = node[2] * 255.0f;
+    }
+    _dirty = false;
+}
+
+void ColorLut::prepare() {
+    cv::AutoLock lock(_mutex);
+    if (_dirty)
+        rebuild();
+}
+
+bool ColorLut::getChannelStages(cv::Mat &table, double &saturation) {
+    cv::AutoLock lock(_mutex);
+    for (int i = 0; i < 9; i++) {
+        if (_ccm[i] != ((i % 4 == 0) ? 1.0 : 0.0))
+            return false;
+    }
+    if (_dirty)
+        rebuild();
+    if (_wb[0] != 1.0 || _wb[1] != 1.0 || _wb[2] != 1.0 || _gamma != 1.0)
+        table = _channelTable.clone();
+    else
+        table.release();
+    saturation = _sat;
+    return true;
+}
+
+void ColorLut::apply(cv::Mat &img) {
+    CV_Assert(img.type() == CV_8UC3);
+    prepare();
+    cv::parallel_for_(cv::Range(0, img.rows), ColorLutBody(img, *this));
+}
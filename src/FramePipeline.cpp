@@ -0,0 +1,253 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#include <iCub/FramePipeline.h>
+
+#include <yarp/os/Time.h>
+
+using namespace std;
+using namespace yarp::os;
+using namespace yarp::sig;
+
+// sequence numbers may wrap, compare by difference
+static inline int seqDiff(unsigned int a, unsigned int b) {
+    return (int)(a - b);
+}
+
+FramePipeline::FramePipeline(const vector<ICalibTool*> &tools, Sink *sink, double maxWait) :
+    _mutex(1), _free(0), _queued(0), _done(0), _warmed(0) {
+    _sink = sink;
+    _maxWait = maxWait > 0 ? maxWait : 0.001;
+    _publisher = NULL;
+    _pushSeq = 0;
+    _nextSeq = 0;
+    _dropped = 0;
+    _running = false;
+
+    // one slot per worker plus one each to hold finished frames waiting for reordering
+    for (size_t i = 0; i < 2 * tools.size(); i++) {
+        Slot *slot = new Slot;
+        slot->state = SLOT_FREE;
+        slot->seq = 0;
+        slot->ok = false;
+        slot->outs.rgb = &slot->rgb;
+        _slots.push_back(slot);
+        _free.post();
+    }
+    for (size_t i = 0; i < tools.size(); i++)
+        _workers.push_back(new Worker(this, tools[i]));
+    _publisher = new Publisher(this);
+}
+
+FramePipeline::~FramePipeline() {
+    stop();
+    for (size_t i = 0; i < _workers.size(); i++)
+        delete _workers[i];
+    _workers.clear();
+    delete _publisher;
+    _publisher = NULL;
+    for (size_t i = 0; i < _slots.size(); i++)
+        delete _slots[i];
+    _slots.clear();
+}
+
+void FramePipeline::setPlacement(const ThreadPlacement &workers, const ThreadPlacement &publisher) {
+    _workerPlacement = workers;
+    _publishPlacement = publisher;
+}
+
+void FramePipeline::setOutputs(bool rgb, bool mono, bool nv12, bool i420) {
+    for (size_t i = 0; i < _slots.size(); i++) {
+        Slot *slot = _slots[i];
+        slot->outs.rgb = rgb ? &slot->rgb : NULL;
+        slot->outs.mono = mono ? &slot->mono : NULL;
+        slot->outs.nv12 = nv12 ? &slot->nv12 : NULL;
+        slot->outs.i420 = i420 ? &slot->i420 : NULL;
+    }
+}
+
+bool FramePipeline::start() {
+    _running = true;
+    bool ok = _publisher->start();
+    int started = 0;
+    for (size_t i = 0; i < _workers.size(); i++) {
+        if (_workers[i]->start())
+            started++;
+        else
+            ok = false;
+    }
+    // workers warm up concurrently, each on its own placed thread
+    for (int i = 0; i < started; i++)
+        _warmed.wait();
+    return ok;
+}
+
+void FramePipeline::stop() {
+    _mutex.wait();
+    if (!_running) {
+        _mutex.post();
+        return;
+    }
+    _running = false;
+    _mutex.post();
+
+    // wake everybody up, loops check _running after each wait
+    for (size_t i = 0; i < _workers.size(); i++)
+        _queued.post();
+    _done.post();
+    _free.post();
+
+    for (size_t i = 0; i < _workers.size(); i++)
+        _workers[i]->stop();
+    _publisher->stop();
+}
+
+void FramePipeline::push(const ImageOf<PixelRgb> &in, const Stamp &stamp, double receive) {
+    _free.wait();
+
+    _mutex.wait();
+    if (!_running) {
+        _mutex.post();
+        _free.post();
+        return;
+    }
+    Slot *slot = NULL;
+    for (size_t i = 0; i < _slots.size() && slot == NULL; i++) {
+        if (_slots[i]->state == SLOT_FREE)
+            slot = _slots[i];
+    }
+    // busy while filling, neither workers nor publisher touch it
+    slot->state = SLOT_BUSY;
+    slot->seq = _pushSeq++;
+    _mutex.post();
+
+    slot->in.copy(in);
+    slot->stamp = stamp;
+    slot->receive = receive;
+
+    _mutex.wait();
+    slot->state = SLOT_QUEUED;
+    _mutex.post();
+    _queued.post();
+}
+
+unsigned int FramePipeline::getDropped() {
+    _mutex.wait();
+    unsigned int dropped = _dropped;
+    _mutex.post();
+    return dropped;
+}
+
+void FramePipeline::workerLoop(ICalibTool *tool) {
+    _workerPlacement.apply("worker");
+    _sink->warmUp(tool);
+    _warmed.post();
+
+    while (true) {
+        _queued.wait();
+
+        _mutex.wait();
+        if (!_running) {
+            _mutex.post();
+            break;
+        }
+        Slot *job = NULL;
+        for (size_t i = 0; i < _slots.size(); i++) {
+            Slot *slot = _slots[i];
+            if (slot->state != SLOT_QUEUED)
+                continue;
+            // already skipped by the publisher, not worth processing
+            if (seqDiff(slot->seq, _nextSeq) < 0) {
+                slot->state = SLOT_FREE;
+                _free.post();
+            }
+            else if (job == NULL || seqDiff(slot->seq, job->seq) < 0)
+                job = slot;
+        }
+        if (job != NULL)
+            job->state = SLOT_BUSY;
+        _mutex.post();
+
+        if (job == NULL)
+            continue;
+
+        _sink->beforeApply(tool);
+        job->start = Time::now();
+        job->ok = tool->apply(job->in, job->outs);
+        job->end = Time::now();
+
+        _mutex.wait();
+        job->state = SLOT_DONE;
+        _mutex.post();
+        _done.post();
+    }
+}
+
+void FramePipeline::publisherLoop() {
+    _publishPlacement.apply("publisher");
+
+    double laterDoneSince = -1.0;
+    while (true) {
+        _done.waitWithTimeout(_maxWait);
+
+        _mutex.wait();
+        if (!_running) {
+            _mutex.post();
+            break;
+        }
+
+        bool progress = true;
+        while (progress) {
+            progress = false;
+            Slot *next = NULL;
+            bool laterDone = false;
+            for (size_t i = 0; i < _slots.size(); i++) {
+                Slot *slot = _slots[i];
+                if (slot->state != SLOT_DONE)
+                    continue;
+                int d = seqDiff(slot->seq, _nextSeq);
+                if (d < 0) {
+                    // skipped earlier, arrived too late
+                    slot->state = SLOT_FREE;
+                    _free.post();
+                }
+                else if (d == 0)
+                    next = slot;
+                else
+                    laterDone = true;
+            }
+
+            if (next != NULL) {
+                // a frame the tool rejected leaves its buffers unfilled
+                if (next->ok) {
+                    _mutex.post();
+                    _sink->publish(next->outs, next->stamp, next->receive, next->start, next->end);
+                    _mutex.wait();
+                }
+                else
+                    _dropped++;
+                next->state = SLOT_FREE;
+                _free.post();
+                _nextSeq++;
+                laterDoneSince = -1.0;
+                progress = true;
+            }
+            else if (laterDone) {
+                double now = Time::now();
+                if (laterDoneSince < 0)
+                    laterDoneSince = now;
+                else if (now - laterDoneSince >= _maxWait) {
+                    _nextSeq++;
+                    _dropped++;
+                    laterDoneSince = -1.0;
+                    progress = true;
+                }
+            }
+        }
+        _mutex.post();
+    }
+}
@@ -0,0 +1,140 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#include <iCub/FrameRecorder.h>
+
+#include <stdio.h>
+
+using namespace std;
+using namespace yarp::os;
+using namespace yarp::sig;
+
+FrameRecorder::FrameRecorder(int queue, int chunkFrames) :
+    _writer(chunkFrames), _mutex(1), _items(0), _control(1) {
+    for (int i = 0; i < (queue > 0 ? queue : 1); i++)
+        _queue.push_back(new Entry);
+    _head = 0;
+    _count = 0;
+    _dropped = 0;
+    _writeErrors = 0;
+    _recording = false;
+}
+
+FrameRecorder::~FrameRecorder() {
+    stopRecording();
+    for (size_t i = 0; i < _queue.size(); i++)
+        delete _queue[i];
+    _queue.clear();
+}
+
+bool FrameRecorder::record(const string &file) {
+    stopRecording();
+
+    _control.wait();
+    if (!_writer.open(file.c_str())) {
+        fprintf(stdout, "====> warning: could not open recording %s\n", file.c_str());
+        _control.post();
+        return false;
+    }
+    _mutex.wait();
+    _head = 0;
+    _count = 0;
+    _dropped = 0;
+    _writeErrors = 0;
+    _file = file;
+    _recording = true;
+    _mutex.post();
+    bool ok = start();
+    _control.post();
+    return ok;
+}
+
+void FrameRecorder::stopRecording() {
+    _control.wait();
+    _mutex.wait();
+    bool wasRecording = _recording;
+    _recording = false;
+    _mutex.post();
+    if (wasRecording) {
+        // the writer thread drains the queue before it exits
+        stop();
+        if (!_writer.close())
+            _writeErrors++;
+        fprintf(stdout, "recording: %s\n", status().c_str());
+    }
+    _control.post();
+}
+
+bool FrameRecorder::isRecording() {
+    _mutex.wait();
+    bool recording = _recording;
+    _mutex.post();
+    return recording;
+}
+
+void FrameRecorder::push(const ImageOf<PixelRgb> &img, const Stamp &stamp, double receive) {
+    _mutex.wait();
+    if (!_recording) {
+        _mutex.post();
+        return;
+    }
+    if (_count == (int)_queue.size()) {
+        _dropped++;
+        _mutex.post();
+        return;
+    }
+    // the writer only reads entries below _count, the copy is safe under the lock
+    Entry *entry = _queue[(_head + _count) % _queue.size()];
+    entry->img.copy(img);
+    entry->seq = stamp.getCount();
+    entry->stamp = stamp.isValid() ? stamp.getTime() : -1.0;
+    entry->receive = receive;
+    _count++;
+    _mutex.post();
+    _items.post();
+}
+
+string FrameRecorder::status() {
+    char buf[512];
+    _mutex.wait();
+    sprintf(buf, "%s %s, %lu frames written, %u dropped, %u write errors",
+            _recording ? "recording" : "stopped", _file.c_str(),
+            _writer.frames(), _dropped, _writeErrors);
+    _mutex.post();
+    return buf;
+}
+
+void FrameRecorder::onStop() {
+    _items.post();
+}
+
+void FrameRecorder::run() {
+    while (true) {
+        _items.wait();
+
+        _mutex.wait();
+        if (_count == 0) {
+            _mutex.post();
+            if (isStopping())
+                break;
+            continue;
+        }
+        Entry *entry = _queue[_head];
+        _mutex.post();
+
+        ImageView view((unsigned char*)entry->img.getRawImage(), entry->img.width(), entry->img.height(),
+                       entry->img.getRowSize(), ImageView::FORMAT_RGB8);
+        bool ok = _writer.append(view, entry->seq, entry->stamp, entry->receive, entry->img.getQuantum());
+
+        _mutex.wait();
+        if (!ok)
+            _writeErrors++;
+        _head = (_head + 1) % _queue.size();
+        _count--;
+        _mutex.post();
+    }
+}
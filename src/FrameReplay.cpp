@@ -0,0 +1,123 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#include <iCub/FrameReplay.h>
+
+#include <stdio.h>
+
+#include <yarp/os/Time.h>
+
+using namespace std;
+using namespace yarp::os;
+using namespace yarp::sig;
+
+FrameReplay::FrameReplay() : _mutex(1) {
+    _target = NULL;
+    _speed = 1.0;
+    _loop = false;
+    _done = false;
+    _fed = 0;
+    _elapsed = 0.0;
+}
+
+bool FrameReplay::open(const string &file) {
+    if (!_reader.open(file.c_str())) {
+        fprintf(stdout, "====> warning: could not open recording %s\n", file.c_str());
+        return false;
+    }
+    if (_reader.recovered())
+        fprintf(stdout, "====> warning: recording %s has no valid index, %d frames recovered by scanning\n",
+                file.c_str(), _reader.count());
+
+    // frames are wrapped, not converted: the row layout must be one YARP can describe
+    for (int i = 0; i < _reader.count(); i++) {
+        ImageView view;
+        RawFrameInfo info;
+        if (!_reader.frame(i, view, info) || view.format != ImageView::FORMAT_RGB8) {
+            fprintf(stdout, "====> warning: frame %d of %s is not an rgb frame\n", i, file.c_str());
+            _reader.close();
+            return false;
+        }
+        ImageOf<PixelRgb> img;
+        img.setQuantum(info.rowAlign);
+        img.resize(view.width, view.height);
+        if (img.getRowSize() != view.stride) {
+            fprintf(stdout, "====> warning: frame %d of %s has an unsupported row stride %d\n", i, file.c_str(), view.stride);
+            _reader.close();
+            return false;
+        }
+    }
+    fprintf(stdout, "replay: %s, %d frames\n", file.c_str(), _reader.count());
+    return _reader.count() > 0;
+}
+
+bool FrameReplay::isDone() {
+    _mutex.wait();
+    bool done = _done;
+    _mutex.post();
+    return done;
+}
+
+void FrameReplay::getProgress(unsigned int &fed, double &elapsed) {
+    _mutex.wait();
+    fed = _fed;
+    elapsed = _elapsed;
+    _mutex.post();
+}
+
+void FrameReplay::run() {
+    if (_target == NULL)
+        return;
+
+    double tStart = Time::now();
+    unsigned int seqOffset = 0;
+    do {
+        double tPass = Time::now();
+        double firstReceive = 0.0;
+        unsigned int firstSeq = 0, lastSeq = 0;
+        for (int i = 0; i < _reader.count() && !isStopping(); i++) {
+            ImageView view;
+            RawFrameInfo info;
+            _reader.frame(i, view, info);
+            if (i == 0) {
+                firstReceive = info.receive;
+                firstSeq = info.seq;
+            }
+
+            double now = Time::now();
+            if (_speed > 0) {
+                double due = tPass + (info.receive - firstReceive) / _speed;
+                if (due > now) {
+                    Time::delay(due - now);
+                    now = Time::now();
+                }
+            }
+
+            // zero copy: the image points into the mapping
+            ImageOf<PixelRgb> img;
+            img.setQuantum(info.rowAlign);
+            img.setExternal(view.data, view.width, view.height);
+
+            // stamps keep the recorded count, times are moved to now so latencies stay meaningful
+            double time = (_speed > 0 && info.stamp >= 0) ? tPass + (info.stamp - firstReceive) / _speed : now;
+            Stamp stamp(info.seq + seqOffset, time);
+            _target->process(img, stamp, now);
+            lastSeq = info.seq;
+
+            _mutex.wait();
+            _fed++;
+            _elapsed = Time::now() - tStart;
+            _mutex.post();
+        }
+        // looped passes continue the stamp count so consumers see no gap
+        seqOffset += lastSeq - firstSeq + 1;
+    } while (_loop && !isStopping());
+
+    _mutex.wait();
+    _done = true;
+    _mutex.post();
+}
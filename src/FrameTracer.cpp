@@ -0,0 +1,170 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#include <iCub/FrameTracer.h>
+
+#include <stdio.h>
+
+#include <yarp/os/Time.h>
+
+using namespace std;
+using namespace yarp::os;
+
+// upper bin edges of the latency histogram in ms, last bin is open ended
+static const double histEdges[FrameTracer::HIST_BINS - 1] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000 };
+
+FrameTracer::FrameTracer(int capacity) : _mutex(1) {
+    _ring.resize(capacity > 0 ? capacity : 1);
+    _enabled = false;
+    _requested = false;
+    _seq = 0;
+    _inFrame = false;
+    reset();
+}
+
+void FrameTracer::setEnabled(bool on) {
+    _mutex.wait();
+    _requested = on;
+    _mutex.post();
+}
+
+bool FrameTracer::isEnabled() {
+    _mutex.wait();
+    bool on = _requested;
+    _mutex.post();
+    return on;
+}
+
+void FrameTracer::reset() {
+    _mutex.wait();
+    _head = 0;
+    _count = 0;
+    for (int i = 0; i < HIST_BINS; i++)
+        _hist[i] = 0;
+    _latSum = 0.0;
+    _latMax = 0.0;
+    _latCount = 0;
+    _mutex.post();
+}
+
+void FrameTracer::beginFrame(double capture, double receive) {
+    // the frame and stage state belongs to the processing thread, which
+    // takes over enable requests here, between frames
+    _mutex.wait();
+    _enabled = _requested;
+    _mutex.post();
+    _inFrame = false;
+    if (!_enabled)
+        return;
+    _current.seq = _seq++;
+    _current.capture = capture > 0 ? capture : receive;
+    _current.receive = receive;
+    _current.publish = -1.0;
+    _current.nStages = 0;
+    _inFrame = true;
+}
+
+void FrameTracer::beginStage(const char *name) {
+    if (!_inFrame || _current.nStages >= MAX_STAGES)
+        return;
+    Stage &s = _current.stages[_current.nStages++];
+    s.name = name;
+    s.start = Time::now();
+    s.end = -1.0;
+}
+
+void FrameTracer::endStage() {
+    if (!_inFrame || _current.nStages == 0)
+        return;
+    _current.stages[_current.nStages - 1].end = Time::now();
+}
+
+void FrameTracer::addStage(const char *name, double start, double end) {
+    if (!_inFrame || _current.nStages >= MAX_STAGES)
+        return;
+    Stage &s = _current.stages[_current.nStages++];
+    s.name = name;
+    s.start = start;
+    s.end = end;
+}
+
+void FrameTracer::endFrame(double publish) {
+    if (!_inFrame)
+        return;
+    _inFrame = false;
+    _current.publish = publish;
+
+    double latency = (publish - _current.capture) * 1000.0;
+    int bin = 0;
+    while (bin < HIST_BINS - 1 && latency > histEdges[bin])
+        bin++;
+
+    _mutex.wait();
+    _ring[_head] = _current;
+    _head = (_head + 1) % _ring.size();
+    if (_count < _ring.size())
+        _count++;
+    _hist[bin]++;
+    _latSum += latency;
+    if (latency > _latMax)
+        _latMax = latency;
+    _latCount++;
+    _mutex.post();
+}
+
+static void writeEvent(FILE *f, bool &first, const char *name, int tid, double start, double end, unsigned int seq) {
+    if (end < start)
+        return;
+    fprintf(f, "%s\n{\"name\":\"%s\",\"cat\":\"camCalib\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+               "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"seq\":%u}}",
+            first ? "" : ",", name, tid, start * 1e6, (end - start) * 1e6, seq);
+    first = false;
+}
+
+bool FrameTracer::dump(const string &file) {
+    FILE *f = fopen(file.c_str(), "w");
+    if (f == NULL)
+        return false;
+
+    _mutex.wait();
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bool first = true;
+    size_t start = (_head + _ring.size() - _count) % _ring.size();
+    for (size_t i = 0; i < _count; i++) {
+        const Record &r = _ring[(start + i) % _ring.size()];
+        // tid 0 carries the end-to-end view, stages go to the processing thread row
+        writeEvent(f, first, "latency", 0, r.capture, r.publish, r.seq);
+        writeEvent(f, first, "transport", 1, r.capture, r.receive, r.seq);
+        for (int s = 0; s < r.nStages; s++)
+            writeEvent(f, first, r.stages[s].name, 1, r.stages[s].start, r.stages[s].end, r.seq);
+    }
+    fprintf(f, "\n]}\n");
+    _mutex.post();
+
+    fclose(f);
+    return true;
+}
+
+void FrameTracer::getStats(Bottle &reply) {
+    _mutex.wait();
+    reply.addString("frames");
+    reply.addInt(_latCount);
+    reply.addString("mean_ms");
+    reply.addDouble(_latCount > 0 ? _latSum / _latCount : 0.0);
+    reply.addString("max_ms");
+    reply.addDouble(_latMax);
+    Bottle &hist = reply.addList();
+    for (int i = 0; i < HIST_BINS; i++) {
+        Bottle &bin = hist.addList();
+        if (i < HIST_BINS - 1)
+            bin.addDouble(histEdges[i]);
+        else
+            bin.addString("inf");
+        bin.addInt(_hist[i]);
+    }
+    _mutex.post();
+}
@@ -0,0 +1,94 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#include <iCub/JpegSliceEncoder.h>
+
+#include <algorithm>
+
+#include <yarp/os/Value.h>
+
+using namespace std;
+using namespace yarp::os;
+
+namespace {
+
+class JpegSliceBody : public cv::ParallelLoopBody
+{
+private:
+    const cv::Mat               &rgb;
+    int                         rowsPerSlice;
+    vector<int>                 params;
+    vector<cv::Mat>             &scratch;
+    vector<vector<uchar> >      &buffers;
+
+public:
+    JpegSliceBody(const cv::Mat &_rgb, int _rowsPerSlice, int quality,
+                  vector<cv::Mat> &_scratch, vector<vector<uchar> > &_buffers) :
+        rgb(_rgb), rowsPerSlice(_rowsPerSlice), scratch(_scratch), buffers(_buffers) {
+        params.push_back(cv::IMWRITE_JPEG_QUALITY);
+        params.push_back(quality);
+    }
+
+    virtual void operator()(const cv::Range &range) const {
+        for (int i = range.start; i < range.end; i++) {
+            int y0 = i * rowsPerSlice;
+            int y1 = std::min(y0 + rowsPerSlice, rgb.rows);
+            // the encoder expects BGR, swap the band into a reused scratch buffer
+            cv::cvtColor(rgb.rowRange(y0, y1), scratch[i], CV_RGB2BGR);
+            cv::imencode(".jpg", scratch[i], buffers[i], params);
+        }
+    }
+};
+
+}
+
+JpegSliceEncoder::JpegSliceEncoder() {
+    _quality = 85;
+    _slices = 0;
+}
+
+void JpegSliceEncoder::setQuality(int q) {
+    _quality = q < 0 ? 0 : (q > 100 ? 100 : q);
+}
+
+void JpegSliceEncoder::setSlices(int n) {
+    _slices = n < 0 ? 0 : n;
+}
+
+void JpegSliceEncoder::encode(const cv::Mat &rgb, Bottle &out) {
+    CV_Assert(rgb.type() == CV_8UC3);
+
+    // bands are multiples of 16 rows so chroma subsampling does not cross slice borders
+    int slices = _slices > 0 ? _slices : cv::getNumThreads();
+    if (slices < 1)
+        slices = 1;
+    int rowsPerSlice = ((rgb.rows + slices - 1) / slices + 15) / 16 * 16;
+    if (rowsPerSlice < 16)
+        rowsPerSlice = 16;
+    slices = (rgb.rows + rowsPerSlice - 1) / rowsPerSlice;
+
+    if ((int)_scratch.size() < slices) {
+        _scratch.resize(slices);
+        _buffers.resize(slices);
+    }
+    cv::parallel_for_(cv::Range(0, slices), JpegSliceBody(rgb, rowsPerSlice, _quality, _scratch, _buffers));
+
+    out.clear();
+    Bottle &header = out.addList();
+    header.addString("jpeg");
+    header.addInt(rgb.cols);
+    header.addInt(rgb.rows);
+    header.addInt(_quality);
+    Bottle &bands = out.addList();
+    for (int i = 0; i < slices; i++) {
+        Bottle &band = bands.addList();
+        int y0 = i * rowsPerSlice;
+        band.addInt(y0);
+        band.addInt(std::min(y0 + rowsPerSlice, rgb.rows) - y0);
+        band.add(Value::makeBlob(&_buffers[i][0], (int)_buffers[i].size()));
+    }
+}
@@ -0,0 +1,120 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#include <iCub/OutputConverter.h>
+
+namespace {
+
+// 8 bit fixed point, offsets keep the shifted values non-negative
+inline uchar lumaFull(const uchar *p) {
+    return (uchar)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+}
+
+inline uchar lumaVideo(const uchar *p) {
+    return (uchar)(((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16);
+}
+
+inline uchar chromaU(int r, int g, int b) {
+    return (uchar)((-38 * r - 74 * g + 112 * b + 128 + (128 << 8)) >> 8);
+}
+
+inline uchar chromaV(int r, int g, int b) {
+    return (uchar)((112 * r - 94 * g - 18 * b + 128 + (128 << 8)) >> 8);
+}
+
+class OutputConverterBody : public cv::ParallelLoopBody
+{
+private:
+    const cv::Mat   &rgb;
+    ImageView       out;
+    const ColorLut  *lut;
+
+public:
+    OutputConverterBody(const cv::Mat &_rgb, const ImageView &_out, const ColorLut *_lut) :
+        rgb(_rgb), out(_out), lut(_lut) {
+    }
+
+    virtual void operator()(const cv::Range &range) const {
+        if (out.format == ImageView::FORMAT_MONO8) {
+            uchar tmp[3];
+            for (int y = range.start; y < range.end; y++) {
+                const uchar *s = rgb.ptr<uchar>(y);
+                uchar *d = out.data + y * out.stride;
+                for (int x = 0; x < out.width; x++, s += 3) {
+                    const uchar *p = s;
+                    if (lut) {
+                        lut->lookup(s, tmp);
+                        p = tmp;
+                    }
+                    d[x] = lumaFull(p);
+                }
+            }
+            return;
+        }
+
+        // 4:2:0, one pair of rows per iteration
+        uchar *chroma = out.data + out.height * out.stride;
+        uchar tmp[4][3];
+        for (int j = range.start; j < range.end; j++) {
+            const uchar *s0 = rgb.ptr<uchar>(2 * j);
+            const uchar *s1 = rgb.ptr<uchar>(2 * j + 1);
+            uchar *y0 = out.data + 2 * j * out.stride;
+            uchar *y1 = y0 + out.stride;
+            uchar *u, *v;
+            int step;
+            if (out.format == ImageView::FORMAT_NV12) {
+                u = chroma + j * out.stride;
+                v = u + 1;
+                step = 2;
+            } else {
+                int cstride = out.stride / 2;
+                u = chroma + j * cstride;
+                v = chroma + (out.height / 2 + j) * cstride;
+                step = 1;
+            }
+            for (int x = 0; x < out.width; x += 2, u += step, v += step) {
+                const uchar *p[4] = { s0 + 3 * x, s0 + 3 * x + 3, s1 + 3 * x, s1 + 3 * x + 3 };
+                if (lut) {
+                    for (int k = 0; k < 4; k++) {
+                        lut->lookup(p[k], tmp[k]);
+                        p[k] = tmp[k];
+                    }
+                }
+                y0[x]     = lumaVideo(p[0]);
+                y0[x + 1] = lumaVideo(p[1]);
+                y1[x]     = lumaVideo(p[2]);
+                y1[x + 1] = lumaVideo(p[3]);
+                int r = (p[0][0] + p[1][0] + p[2][0] + p[3][0] + 2) >> 2;
+                int g = (p[0][1] + p[1][1] + p[2][1] + p[3][1] + 2) >> 2;
+                int b = (p[0][2] + p[1][2] + p[2][2] + p[3][2] + 2) >> 2;
+                *u = chromaU(r, g, b);
+                *v = chromaV(r, g, b);
+            }
+        }
+    }
+};
+
+}
+
+bool OutputConverter::convert(const cv::Mat &rgb, const ImageView &out, const ColorLut *lut) {
+    if (rgb.type() != CV_8UC3 || rgb.cols != out.width || rgb.rows != out.height)
+        return false;
+
+    int rows;
+    if (out.format == ImageView::FORMAT_MONO8)
+        rows = out.height;
+    else if (out.format == ImageView::FORMAT_NV12 || out.format == ImageView::FORMAT_I420) {
+        if ((out.width & 1) || (out.height & 1) || (out.stride & 1))
+            return false;
+        rows = out.height / 2;
+    }
+    else
+        return false;
+
+    cv::parallel_for_(cv::Range(0, rows), OutputConverterBody(rgb, out, lut));
+    return true;
+}
@@ -0,0 +1,387 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#include <iCub/ProcessingBackend.h>
+#include <iCub/TiledRemap.h>
+
+#include <string.h>
+
+#include <opencv2/core/version.hpp>
+#include <opencv2/opencv_modules.hpp>
+
+// one CUDA implementation for the gpu (OpenCV 2) and cuda (OpenCV 3) modules
+#if CV_MAJOR_VERSION == 2 && defined(HAVE_OPENCV_GPU)
+    #include <opencv2/gpu/gpu.hpp>
+    namespace cvcuda = cv::gpu;
+    #define CAMCALIB_HAVE_CUDA
+#elif CV_MAJOR_VERSION >= 3 && defined(HAVE_OPENCV_CUDAARITHM) && defined(HAVE_OPENCV_CUDAFILTERS) && \
+      defined(HAVE_OPENCV_CUDAIMGPROC) && defined(HAVE_OPENCV_CUDAWARPING)
+    #include <opencv2/cudaarithm.hpp>
+    #include <opencv2/cudafilters.hpp>
+    #include <opencv2/cudaimgproc.hpp>
+    #include <opencv2/cudawarping.hpp>
+    namespace cvcuda = cv::cuda;
+    #define CAMCALIB_HAVE_CUDA
+#endif
+
+#if CV_MAJOR_VERSION >= 3
+    #include <opencv2/core/ocl.hpp>
+    #define CAMCALIB_HAVE_OPENCL
+#endif
+
+using namespace std;
+
+namespace {
+
+#if CV_MAJOR_VERSION >= 3
+    const int BAYER_HQ = cv::COLOR_BayerGB2BGR_EA;
+#else
+    const int BAYER_HQ = CV_BayerGB2BGR_VNG;
+#endif
+
+#ifdef CAMCALIB_HAVE_CUDA
+
+class CudaBackend : public ProcessingBackend
+{
+private:
+    cvcuda::GpuMat  _mapx;
+    cvcuda::GpuMat  _mapy;
+    cvcuda::GpuMat  _raw;
+    cvcuda::GpuMat  _gray;
+    cvcuda::GpuMat  _a;
+    cvcuda::GpuMat  _b;
+    cvcuda::GpuMat  _luma;
+    cvcuda::GpuMat  *_cur;
+    cvcuda::GpuMat  *_spare;
+#if CV_MAJOR_VERSION >= 3
+    // building the filter allocates and uploads the kernel, keep it
+    cv::Ptr<cv::cuda::Filter> _blur;
+    int             _blurType;
+    // same for the color table, rebuilt when its contents change
+    cv::Ptr<cv::cuda::LookUpTable> _lut;
+    cv::Mat         _lutTable;
+#endif
+    cvcuda::GpuMat  _hsv;
+
+    void swap() {
+        cvcuda::GpuMat *t = _cur;
+        _cur = _spare;
+        _spare = t;
+    }
+
+public:
+#if CV_MAJOR_VERSION >= 3
+    CudaBackend() : _cur(&_a), _spare(&_b), _blurType(-1) {}
+#else
+    CudaBackend() : _cur(&_a), _spare(&_b) {}
+#endif
+
+    virtual int kind() const { return CalibParams::BACKEND_CUDA; }
+
+    virtual void setMaps(const cv::Mat &mapx, const cv::Mat &mapy) {
+        _mapx.upload(mapx);
+        _mapy.upload(mapy);
+    }
+
+    virtual void upload(const cv::Mat &in) {
+        if (in.channels() == 1) {
+            _gray.upload(in);
+        } else {
+            _raw.upload(in);
+            cvcuda::cvtColor(_raw, _gray, CV_BGR2GRAY);
+        }
+    }
+
+    virtual void demosaic(int mode) {
+        int code = mode == CalibParams::DEMOSAIC_BILINEAR ? (int)CV_BayerGB2BGR : (int)cvcuda::COLOR_BayerGB2BGR_MHT;
+        _cur = &_a;
+        _spare = &_b;
+        cvcuda::demosaicing(_gray, *_cur, code);
+    }
+
+    virtual void remap(const cv::Size &size) {
+        cvcuda::remap(*_cur, *_spare, _mapx, _mapy, cv::INTER_LINEAR);
+        if (size.area() > 0)
+            cvcuda::resize(*_spare, *_cur, size);
+        else
+            swap();
+    }
+
+    virtual bool color(const cv::Mat &table, double saturation) {
+        if (!table.empty()) {
+            #if CV_MAJOR_VERSION == 2
+                cvcuda::LUT(*_cur, table, *_spare);
+            #else
+                if (_lut.empty() || _lutTable.empty() || memcmp(_lutTable.data, table.data, 256 * 3) != 0) {
+                    _lut = cv::cuda::createLookUpTable(table);
+                    table.copyTo(_lutTable);
+                }
+                _lut->transform(*_cur, *_spare);
+            #endif
+            swap();
+        }
+        if (saturation != 0) {
+            cvcuda::cvtColor(*_cur, _hsv, CV_RGB2HSV);
+            cvcuda::add(_hsv, cv::Scalar(0, saturation, 0), _hsv);
+            cvcuda::cvtColor(_hsv, *_cur, CV_HSV2RGB);
+        }
+        return true;
+    }
+
+    virtual void sharpen(double amount) {
+        #if CV_MAJOR_VERSION == 2
+            cvcuda::GaussianBlur(*_cur, *_spare, cv::Size(5, 5), 5);
+        #else
+            if (_blur.empty() || _blurType != _cur->type()) {
+                _blur = cv::cuda::createGaussianFilter(_cur->type(), _cur->type(), cv::Size(5, 5), 5);
+                _blurType = _cur->type();
+            }
+            _blur->apply(*_cur, *_spare);
+        #endif
+        cvcuda::addWeighted(*_cur, 1.0 + amount, *_spare, -amount, 0, *_spare);
+        swap();
+    }
+
+    virtual void download(cv::Mat &rgb) {
+        _cur->download(rgb);
+    }
+
+    virtual void downloadGray(cv::Mat &gray) {
+        cvcuda::cvtColor(*_cur, _luma, CV_RGB2GRAY);
+        _luma.download(gray);
+    }
+};
+
+#endif
+
+// host side frames stay in place, device side ones are copied
+inline void assign(const cv::Mat &in, cv::Mat &dst) {
+    dst = in;
+}
+
+// the CPU backend leaves color to the host LUT, fused into the conversion
+inline bool deviceColor(cv::Mat &, cv::Mat &, cv::Mat &, const cv::Mat &, double) {
+    return false;
+}
+
+#ifdef CAMCALIB_HAVE_OPENCL
+inline void assign(const cv::Mat &in, cv::UMat &dst) {
+    in.copyTo(dst);
+}
+
+// per channel table and HSV saturation on the OpenCL device
+inline bool deviceColor(cv::UMat &cur, cv::UMat &spare, cv::UMat &hsv, const cv::Mat &table, double saturation) {
+    if (!table.empty()) {
+        cv::LUT(cur, table, spare);
+        cv::swap(cur, spare);
+    }
+    if (saturation != 0) {
+        cv::cvtColor(cur, hsv, CV_RGB2HSV);
+        cv::add(hsv, cv::Scalar(0, saturation, 0), hsv);
+        cv::cvtColor(hsv, cur, CV_HSV2RGB);
+    }
+    return true;
+}
+
+/** Whole frame demosaicing and remap on the OpenCL device */
+class UMatRemap
+{
+private:
+    cv::UMat    _mapx;
+    cv::UMat    _mapy;
+
+public:
+    void setMaps(const cv::Mat &mapx, const cv::Mat &mapy) {
+        mapx.copyTo(_mapx);
+        mapy.copyTo(_mapy);
+    }
+
+    void apply(const cv::UMat &raw, int code, cv::UMat &scratch, cv::UMat &dst) {
+        cv::cvtColor(raw, scratch, code);
+        cv::remap(scratch, dst, _mapx, _mapy, cv::INTER_LINEAR);
+    }
+};
+#endif
+
+/** Tiles demosaic their own raw window, no whole frame scratch needed */
+class CpuRemap : public TiledRemap
+{
+public:
+    void apply(const cv::Mat &raw, int code, cv::Mat &, cv::Mat &dst) {
+        TiledRemap::apply(raw, code, dst);
+    }
+};
+
+/**
+ * CPU (M = cv::Mat, R = CpuRemap) and OpenCL transparent API (M = cv::UMat,
+ * R = UMatRemap) backends. Demosaicing is deferred and done by R together
+ * with the remap.
+ */
+template <class M, class R>
+class HostBackend : public ProcessingBackend
+{
+private:
+    int _kind;
+    int _code;
+    R   _remap;
+    M   _gray;
+    M   _a;
+    M   _b;
+    M   _luma;
+    M   _hsv;
+    M   *_cur;
+    M   *_spare;
+
+    void swap() {
+        M *t = _cur;
+        _cur = _spare;
+        _spare = t;
+    }
+
+public:
+    HostBackend(int kind) : _kind(kind), _code(BAYER_HQ), _cur(&_a), _spare(&_b) {}
+
+    virtual int kind() const { return _kind; }
+
+    virtual void setMaps(const cv::Mat &mapx, const cv::Mat &mapy) {
+        _remap.setMaps(mapx, mapy);
+    }
+
+    virtual void upload(const cv::Mat &in) {
+        if (in.channels() == 1)
+            assign(in, _gray);
+        else
+            cv::cvtColor(in, _gray, CV_BGR2GRAY);
+    }
+
+    virtual void demosaic(int mode) {
+        _cur = &_a;
+        _spare = &_b;
+        _code = mode == CalibParams::DEMOSAIC_BILINEAR ? (int)CV_BayerGB2BGR : BAYER_HQ;
+    }
+
+    virtual void remap(const cv::Size &size) {
+        _remap.apply(_gray, _code, *_cur, *_spare);
+        if (size.area() > 0)
+            cv::resize(*_spare, *_cur, size);
+        else
+            swap();
+    }
+
+    virtual bool color(const cv::Mat &table, double saturation) {
+        return deviceColor(*_cur, *_spare, _hsv, table, saturation);
+    }
+
+    virtual void sharpen(double amount) {
+        cv::GaussianBlur(*_cur, *_spare, cv::Size(5, 5), 5);
+        cv::addWeighted(*_cur, 1.0 + amount, *_spare, -amount, 0, *_spare);
+        swap();
+    }
+
+    virtual void download(cv::Mat &rgb) {
+        _cur->copyTo(rgb);
+    }
+
+    virtual void downloadGray(cv::Mat &gray) {
+        cv::cvtColor(*_cur, _luma, CV_RGB2GRAY);
+        _luma.copyTo(gray);
+    }
+};
+
+}
+
+bool ProcessingBackend::isAvailable(int kind) {
+    switch (kind) {
+    case CalibParams::BACKEND_AUTO:
+    case CalibParams::BACKEND_CPU:
+        return true;
+    case CalibParams::BACKEND_CUDA:
+        #ifdef CAMCALIB_HAVE_CUDA
+            return cvcuda::getCudaEnabledDeviceCount() > 0;
+        #else
+            return false;
+        #endif
+    case CalibParams::BACKEND_OPENCL:
+        #ifdef CAMCALIB_HAVE_OPENCL
+            return cv::ocl::haveOpenCL();
+        #else
+            return false;
+        #endif
+    }
+    return false;
+}
+
+int ProcessingBackend::best() {
+    if (isAvailable(CalibParams::BACKEND_CUDA))
+        return CalibParams::BACKEND_CUDA;
+#ifdef CAMCALIB_HAVE_OPENCL
+    // OpenCL runtimes on the CPU itself are left to an explicit choice or autotune
+    if (isAvailable(CalibParams::BACKEND_OPENCL)) {
+        cv::ocl::setUseOpenCL(true);
+        const cv::ocl::Device &device = cv::ocl::Device::getDefault();
+        if (device.available() && (device.type() & (cv::ocl::Device::TYPE_GPU | cv::ocl::Device::TYPE_ACCELERATOR)))
+            return CalibParams::BACKEND_OPENCL;
+    }
+#endif
+    return CalibParams::BACKEND_CPU;
+}
+
+ProcessingBackend *ProcessingBackend::create(int kind) {
+    if (kind == CalibParams::BACKEND_AUTO)
+        kind = best();
+    if (!isAvailable(kind))
+        return NULL;
+
+    switch (kind) {
+    #ifdef CAMCALIB_HAVE_CUDA
+    case CalibParams::BACKEND_CUDA:
+        return new CudaBackend();
+    #endif
+    #ifdef CAMCALIB_HAVE_OPENCL
+    case CalibParams::BACKEND_OPENCL:
+        cv::ocl::setUseOpenCL(true);
+        return new HostBackend<cv::UMat, UMatRemap>(CalibParams::BACKEND_OPENCL);
+    #endif
+    case CalibParams::BACKEND_CPU:
+        return new HostBackend<cv::Mat, CpuRemap>(CalibParams::BACKEND_CPU);
+    }
+    return NULL;
+}
+
+const char *ProcessingBackend::name(int kind) {
+    switch (kind) {
+    case CalibParams::BACKEND_AUTO:   return "auto";
+    case CalibParams::BACKEND_CUDA:   return "cuda";
+    case CalibParams::BACKEND_OPENCL: return "opencl";
+    case CalibParams::BACKEND_CPU:    return "cpu";
+    }
+    return "unknown";
+}
+
+const char *ProcessingBackend::demosaicName(int kind, int mode) {
+    if (mode == CalibParams::DEMOSAIC_BILINEAR)
+        return "bilinear";
+    if (kind == CalibParams::BACKEND_AUTO)
+        kind = best();
+    if (kind == CalibParams::BACKEND_CUDA)
+        return "mht";
+#if CV_MAJOR_VERSION >= 3
+    return "ea";
+#else
+    return "vng";
+#endif
+}
+
+bool ProcessingBackend::parse(const string &name, int &kind) {
+    for (int k = CalibParams::BACKEND_AUTO; k <= CalibParams::BACKEND_CPU; k++) {
+        if (name == ProcessingBackend::name(k)) {
+            kind = k;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,217 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#include <iCub/QualityController.h>
+
+#include <stdio.h>
+
+#include <yarp/os/Value.h>
+
+using namespace std;
+using namespace yarp::os;
+
+QualityController::QualityController(const Baseline &base) : _mutex(1) {
+    _base = base;
+    _pending = base;
+    _generation = 0;
+    _budget = 0.0;
+    _parallel = 1;
+    _downscale = 0.5;
+    _window = 30;
+    _downLoad = 0.95;
+    _upLoad = 0.6;
+    _upWindows = 3;
+    _enabled = false;
+    _auto = true;
+    _level = 0;
+    _sum = 0.0;
+    _count = 0;
+    _calmWindows = 0;
+    _load = 0.0;
+    _changes = 0;
+    _inWidth = 0;
+    _inHeight = 0;
+}
+
+const char *QualityController::stepName(int step) {
+    switch (step) {
+    case STEP_SHARPEN:   return "sharpen";
+    case STEP_DEMOSAIC:  return "demosaic";
+    case STEP_DOWNSCALE: return "downscale";
+    }
+    return "full";
+}
+
+void QualityController::configure(Searchable &config, int parallelFrames) {
+    double fps = config.check("targetfps", Value(0.0), "Frame rate kept by degrading quality, 0 = off (double)").asDouble();
+    _enabled = fps > 0;
+    _budget = _enabled ? 1.0 / fps : 0.0;
+    _parallel = parallelFrames > 1 ? parallelFrames : 1;
+    _window = config.check("qualitywindow", Value(30), "Frames per quality decision (int)").asInt();
+    if (_window < 1)
+        _window = 1;
+    _downLoad = config.check("qualitydown", Value(0.95), "Load above which quality is reduced (double)").asDouble();
+    _upLoad = config.check("qualityup", Value(0.6), "Load below which quality is restored (double)").asDouble();
+    _upWindows = config.check("qualityupwindows", Value(3), "Calm windows before quality is restored (int)").asInt();
+    _downscale = config.check("downscale", Value(0.5), "Output scale of the downscale quality step (double)").asDouble();
+
+    // steps that would not change anything at the configured settings are left out
+    Bottle names;
+    if (config.check("qualitysteps") && config.find("qualitysteps").isList())
+        names = *config.find("qualitysteps").asList();
+    else
+        names.fromString("sharpen demosaic downscale");
+    _steps.clear();
+    for (int i = 0; i < names.size(); i++) {
+        ConstString name = names.get(i).asString();
+        if (name == "sharpen") {
+            if (_base.sharpen != 0)
+                _steps.push_back(STEP_SHARPEN);
+        }
+        else if (name == "demosaic") {
+            if (_base.demosaic != ICalibTool::DEMOSAIC_BILINEAR)
+                _steps.push_back(STEP_DEMOSAIC);
+        }
+        else if (name == "downscale") {
+            if (_downscale > 0 && _downscale < 1)
+                _steps.push_back(STEP_DOWNSCALE);
+        }
+        else
+            fprintf(stdout, "====> warning: unknown quality step %s, use sharpen, demosaic or downscale\n", name.c_str());
+    }
+    if (_enabled)
+        fprintf(stdout, "quality: target %g fps, %d degradation steps\n", fps, (int)_steps.size());
+}
+
+void QualityController::applyLevel(int level) {
+    bool noSharpen = false, bilinear = false, downscale = false;
+    for (int i = 0; i < level && i < (int)_steps.size(); i++) {
+        if (_steps[i] == STEP_SHARPEN)
+            noSharpen = true;
+        else if (_steps[i] == STEP_DEMOSAIC)
+            bilinear = true;
+        else if (_steps[i] == STEP_DOWNSCALE)
+            downscale = true;
+    }
+
+    // recorded only, the tools take it over in sync()
+    _pending = _base;
+    _pending.sharpen = noSharpen ? 0.0 : _base.sharpen;
+    _pending.demosaic = bilinear ? (int)ICalibTool::DEMOSAIC_BILINEAR : _base.demosaic;
+    int w = _base.outWidth != 0 ? _base.outWidth : _inWidth;
+    int h = _base.outHeight != 0 ? _base.outHeight : _inHeight;
+    if (downscale && w > 0 && h > 0) {
+        // even sizes keep the 4:2:0 outputs valid
+        _pending.outWidth = ((int)(w * _downscale)) & ~1;
+        _pending.outHeight = ((int)(h * _downscale)) & ~1;
+        _pending.precompose = true;
+    }
+    _generation++;
+
+    if (level != _level) {
+        fprintf(stdout, "quality: level %d -> %d (%s), load %.2f\n", _level, level,
+                level > 0 ? stepName(_steps[level - 1]) : "full", _load);
+        _changes++;
+    }
+    _level = level;
+    _sum = 0.0;
+    _count = 0;
+    _calmWindows = 0;
+}
+
+void QualityController::sync(ICalibTool *tool) {
+    _mutex.wait();
+    // tools never synced have the baseline, which is generation 0
+    unsigned int &seen = _synced[tool];
+    bool changed = seen != _generation;
+    Baseline s = _pending;
+    seen = _generation;
+    _mutex.post();
+
+    if (!changed)
+        return;
+    tool->setSharpen(s.sharpen);
+    tool->setDemosaic(s.demosaic);
+    tool->setOutputSize(s.outWidth, s.outHeight);
+    tool->setPrecompose(s.precompose);
+}
+
+void QualityController::setInputSize(int width, int height) {
+    _mutex.wait();
+    _inWidth = width;
+    _inHeight = height;
+    _mutex.post();
+}
+
+void QualityController::update(double seconds) {
+    if (!_enabled)
+        return;
+
+    _mutex.wait();
+    _sum += seconds;
+    _count++;
+    if (_count >= _window) {
+        // parallel workers share the frame interval
+        _load = _sum / _count / (_budget * _parallel);
+        _sum = 0.0;
+        _count = 0;
+        if (_auto) {
+            if (_load > _downLoad && _level < (int)_steps.size())
+                applyLevel(_level + 1);
+            else if (_load < _upLoad && _level > 0) {
+                if (++_calmWindows >= _upWindows)
+                    applyLevel(_level - 1);
+            }
+            else
+                _calmWindows = 0;
+        }
+    }
+    _mutex.post();
+}
+
+bool QualityController::setLevel(int level) {
+    if (level < 0 || level > (int)_steps.size())
+        return false;
+    _mutex.wait();
+    _auto = false;
+    applyLevel(level);
+    _mutex.post();
+    return true;
+}
+
+void QualityController::setAuto() {
+    _mutex.wait();
+    _auto = _enabled;
+    _sum = 0.0;
+    _count = 0;
+    _calmWindows = 0;
+    _mutex.post();
+}
+
+int QualityController::getLevel() {
+    _mutex.wait();
+    int level = _level;
+    _mutex.post();
+    return level;
+}
+
+void QualityController::getStats(Bottle &reply) {
+    _mutex.wait();
+    reply.addString("level");
+    reply.addInt(_level);
+    reply.addString("step");
+    reply.addString(_level > 0 ? stepName(_steps[_level - 1]) : "full");
+    reply.addString("levels");
+    reply.addInt((int)_steps.size());
+    reply.addString("auto");
+    reply.addInt(_enabled && _auto ? 1 : 0);
+    reply.addString("load");
+    reply.addDouble(_load);
+    reply.addString("changes");
+    reply.addInt((int)_changes);
+    _mutex.post();
+}
@@ -0,0 +1,320 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#include <iCub/RawRecording.h>
+
+#include <string.h>
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+const char      FILE_MAGIC[8] = { 'C', 'C', 'R', 'A', 'W', 'R', 'E', 'C' };
+const uint32_t  FILE_VERSION = 1;
+const uint64_t  ALIGN = 64;
+
+struct RawFileHeader
+{
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    reserved[13];
+};
+
+struct RawIndexHeader
+{
+    RawBlockHeader  block;
+    uint64_t        prev;       ///< offset of the previous index block, 0 = none
+    uint64_t        count;      ///< followed by count frame block offsets
+};
+
+struct RawTrailer
+{
+    RawBlockHeader  block;
+    uint64_t        lastIndex;
+    uint64_t        reserved[5];    ///< keeps the trailer at the very end of an aligned file
+};
+
+inline uint64_t alignUp(uint64_t v) {
+    return (v + ALIGN - 1) / ALIGN * ALIGN;
+}
+
+inline bool isMagic(const RawBlockHeader &h, const char *magic) {
+    return memcmp(h.magic, magic, 4) == 0;
+}
+
+inline void setMagic(RawBlockHeader &h, const char *magic) {
+    memcpy(h.magic, magic, 4);
+    h.reserved = 0;
+}
+
+size_t frameBytes(uint32_t format, uint32_t height, uint32_t stride) {
+    size_t rows = height;
+    if (format == ImageView::FORMAT_NV12 || format == ImageView::FORMAT_I420)
+        rows = height * 3 / 2;
+    return rows * stride;
+}
+
+}
+
+RawRecordingWriter::RawRecordingWriter(int chunkFrames) {
+    _file = NULL;
+    _offset = 0;
+    _lastIndex = 0;
+    _chunkFrames = chunkFrames < 1 ? 1 : chunkFrames;
+    _frames = 0;
+}
+
+RawRecordingWriter::~RawRecordingWriter() {
+    close();
+}
+
+bool RawRecordingWriter::open(const char *file) {
+    close();
+    _file = fopen(file, "wb");
+    if (_file == NULL)
+        return false;
+
+    RawFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.version = FILE_VERSION;
+    if (fwrite(&header, sizeof(header), 1, _file) != 1) {
+        fclose(_file);
+        _file = NULL;
+        return false;
+    }
+    _offset = sizeof(header);
+    _lastIndex = 0;
+    _chunk.clear();
+    _frames = 0;
+    return true;
+}
+
+bool RawRecordingWriter::writeBlock(const void *header, size_t headerSize, const void *data, size_t dataSize) {
+    static const char zeros[ALIGN] = { 0 };
+    uint64_t size = alignUp(headerSize + dataSize);
+    size_t pad = (size_t)(size - headerSize - dataSize);
+    if (fwrite(header, headerSize, 1, _file) != 1)
+        return false;
+    if (dataSize > 0 && fwrite(data, dataSize, 1, _file) != 1)
+        return false;
+    if (pad > 0 && fwrite(zeros, pad, 1, _file) != 1)
+        return false;
+    _offset += size;
+    return true;
+}
+
+bool RawRecordingWriter::writeIndex() {
+    if (_chunk.empty())
+        return true;
+    RawIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    setMagic(header.block, "INDX");
+    header.block.size = alignUp(sizeof(header) + _chunk.size() * sizeof(uint64_t));
+    header.prev = _lastIndex;
+    header.count = _chunk.size();
+    uint64_t offset = _offset;
+    if (!writeBlock(&header, sizeof(header), &_chunk[0], _chunk.size() * sizeof(uint64_t)))
+        return false;
+    _lastIndex = offset;
+    _chunk.clear();
+    // a complete chunk survives the recorder being killed
+    fflush(_file);
+    return true;
+}
+
+bool RawRecordingWriter::append(const ImageView &frame, unsigned int seq, double stamp, double receive, int rowAlign) {
+    if (_file == NULL)
+        return false;
+
+    RawFrameHeader header;
+    memset(&header, 0, sizeof(header));
+    setMagic(header.block, "FRME");
+    header.width = frame.width;
+    header.height = frame.height;
+    header.stride = frame.stride;
+    header.format = frame.format;
+    header.rowAlign = rowAlign;
+    header.seq = seq;
+    header.stamp = stamp;
+    header.receive = receive;
+    size_t bytes = frameBytes(header.format, header.height, header.stride);
+    header.block.size = alignUp(sizeof(header) + bytes);
+
+    uint64_t offset = _offset;
+    if (!writeBlock(&header, sizeof(header), frame.data, bytes))
+        return false;
+    _chunk.push_back(offset);
+    _frames++;
+    if ((int)_chunk.size() >= _chunkFrames)
+        return writeIndex();
+    return true;
+}
+
+bool RawRecordingWriter::close() {
+    if (_file == NULL)
+        return true;
+    bool ok = writeIndex();
+    RawTrailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    setMagic(trailer.block, "TRLR");
+    trailer.block.size = sizeof(trailer);
+    trailer.lastIndex = _lastIndex;
+    ok = ok && writeBlock(&trailer, sizeof(trailer), NULL, 0);
+    ok = (fclose(_file) == 0) && ok;
+    _file = NULL;
+    return ok;
+}
+
+RawRecordingReader::RawRecordingReader() {
+    _base = NULL;
+    _size = 0;
+    _recovered = false;
+}
+
+RawRecordingReader::~RawRecordingReader() {
+    close();
+}
+
+bool RawRecordingReader::open(const char *file) {
+    close();
+
+#ifndef _WIN32
+    int fd = ::open(file, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(RawFileHeader)) {
+        ::close(fd);
+        return false;
+    }
+    // private writable mapping: pages are only copied if a consumer writes
+    void *base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED)
+        return false;
+    _base = (unsigned char*)base;
+    _size = (size_t)st.st_size;
+    madvise(_base, _size, MADV_SEQUENTIAL);
+#else
+    // no mapping, the whole file is read into memory
+    FILE *f = fopen(file, "rb");
+    if (f == NULL)
+        return false;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < (long)sizeof(RawFileHeader)) {
+        fclose(f);
+        return false;
+    }
+    _buffer.resize(size);
+    bool read = fread(&_buffer[0], size, 1, f) == 1;
+    fclose(f);
+    if (!read) {
+        _buffer.clear();
+        return false;
+    }
+    _base = &_buffer[0];
+    _size = (size_t)size;
+#endif
+
+    const RawFileHeader *header = (const RawFileHeader*)_base;
+    if (memcmp(header->magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || header->version != FILE_VERSION) {
+        close();
+        return false;
+    }
+
+    _recovered = !readIndex();
+    if (_recovered)
+        scanBlocks();
+    return true;
+}
+
+bool RawRecordingReader::readIndex() {
+    _frames.clear();
+    if (_size < sizeof(RawFileHeader) + sizeof(RawTrailer))
+        return false;
+    const RawTrailer *trailer = (const RawTrailer*)(_base + _size - sizeof(RawTrailer));
+    if (!isMagic(trailer->block, "TRLR"))
+        return false;
+
+    // index blocks are linked backwards, chunks are collected in reverse
+    vector<vector<uint64_t> > chunks;
+    uint64_t index = trailer->lastIndex;
+    while (index != 0) {
+        if (index + sizeof(RawIndexHeader) > _size)
+            return false;
+        const RawIndexHeader *header = (const RawIndexHeader*)(_base + index);
+        if (!isMagic(header->block, "INDX") || index + sizeof(RawIndexHeader) + header->count * sizeof(uint64_t) > _size)
+            return false;
+        const uint64_t *offsets = (const uint64_t*)(header + 1);
+        chunks.push_back(vector<uint64_t>(offsets, offsets + header->count));
+        if (header->prev >= index)
+            return false;
+        index = header->prev;
+    }
+    for (size_t c = chunks.size(); c > 0; c--)
+        _frames.insert(_frames.end(), chunks[c - 1].begin(), chunks[c - 1].end());
+
+    for (size_t i = 0; i < _frames.size(); i++) {
+        if (_frames[i] + sizeof(RawFrameHeader) > _size ||
+            !isMagic(((const RawFrameHeader*)(_base + _frames[i]))->block, "FRME")) {
+            _frames.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+void RawRecordingReader::scanBlocks() {
+    _frames.clear();
+    uint64_t offset = sizeof(RawFileHeader);
+    while (offset + sizeof(RawBlockHeader) <= _size) {
+        const RawBlockHeader *block = (const RawBlockHeader*)(_base + offset);
+        if (block->size < sizeof(RawBlockHeader) || offset + block->size > _size)
+            break;      // truncated by the killed recorder
+        if (isMagic(*block, "FRME"))
+            _frames.push_back(offset);
+        else if (!isMagic(*block, "INDX") && !isMagic(*block, "TRLR"))
+            break;
+        offset += block->size;
+    }
+}
+
+void RawRecordingReader::close() {
+#ifndef _WIN32
+    if (_base != NULL)
+        munmap(_base, _size);
+#endif
+    _buffer.clear();
+    _base = NULL;
+    _size = 0;
+    _frames.clear();
+    _recovered = false;
+}
+
+bool RawRecordingReader::frame(int i, ImageView &view, RawFrameInfo &info) const {
+    if (i < 0 || i >= (int)_frames.size())
+        return false;
+    const RawFrameHeader *header = (const RawFrameHeader*)(_base + _frames[i]);
+    if (_frames[i] + sizeof(RawFrameHeader) + frameBytes(header->format, header->height, header->stride) > _size)
+        return false;
+    view = ImageView(_base + _frames[i] + sizeof(RawFrameHeader), header->width, header->height,
+                     header->stride, (ImageView::Format)header->format);
+    info.seq = header->seq;
+    info.stamp = header->stamp;
+    info.receive = header->receive;
+    info.rowAlign = header->rowAlign;
+    return true;
+}
@@ -0,0 +1,149 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#include <iCub/RoiPublisher.h>
+
+#include <stdio.h>
+
+using namespace std;
+using namespace yarp::os;
+using namespace yarp::sig;
+
+RoiPublisher::RoiPublisher() : _mutex(1) {
+    _tool = NULL;
+    _prefix = "/roi/";
+    _nextId = 0;
+}
+
+RoiPublisher::~RoiPublisher() {
+    // the tool may be gone already
+    _tool = NULL;
+    close();
+}
+
+RoiPublisher::Roi *RoiPublisher::find(const string &name) {
+    for (size_t i = 0; i < _rois.size(); i++) {
+        if (_rois[i]->name == name)
+            return _rois[i];
+    }
+    return NULL;
+}
+
+bool RoiPublisher::add(const string &name, int cx, int cy, int w, int h) {
+    if (name.empty() || w <= 0 || h <= 0)
+        return false;
+
+    _mutex.wait();
+    Roi *roi = find(name);
+    if (roi == NULL) {
+        roi = new Roi;
+        roi->name = name;
+        roi->id = _nextId++;
+        if (!roi->port.open((_prefix + name).c_str())) {
+            fprintf(stdout, "====> warning: could not open roi port %s%s\n", _prefix.c_str(), name.c_str());
+            delete roi;
+            _mutex.post();
+            return false;
+        }
+        _rois.push_back(roi);
+    }
+    roi->cx = cx;
+    roi->cy = cy;
+    roi->w = w;
+    roi->h = h;
+    // the tool may be inside a frame on the processing thread
+    Change change;
+    change.id = roi->id;
+    change.remove = false;
+    change.x = cx - w / 2;
+    change.y = cy - h / 2;
+    change.w = w;
+    change.h = h;
+    _changes.push_back(change);
+    _mutex.post();
+    return true;
+}
+
+bool RoiPublisher::remove(const string &name) {
+    _mutex.wait();
+    for (size_t i = 0; i < _rois.size(); i++) {
+        Roi *roi = _rois[i];
+        if (roi->name == name) {
+            Change change;
+            change.id = roi->id;
+            change.remove = true;
+            _changes.push_back(change);
+            roi->port.close();
+            delete roi;
+            _rois.erase(_rois.begin() + i);
+            _mutex.post();
+            return true;
+        }
+    }
+    _mutex.post();
+    return false;
+}
+
+void RoiPublisher::list(Bottle &reply) {
+    _mutex.wait();
+    for (size_t i = 0; i < _rois.size(); i++) {
+        Bottle &b = reply.addList();
+        b.addString(_rois[i]->name.c_str());
+        b.addInt(_rois[i]->cx);
+        b.addInt(_rois[i]->cy);
+        b.addInt(_rois[i]->w);
+        b.addInt(_rois[i]->h);
+    }
+    _mutex.post();
+}
+
+void RoiPublisher::process(const ImageOf<PixelRgb> &in, Stamp &stamp) {
+    _mutex.wait();
+    for (size_t i = 0; i < _changes.size() && _tool != NULL; i++) {
+        const Change &change = _changes[i];
+        if (change.remove)
+            _tool->removeRoi(change.id);
+        else
+            _tool->setRoi(change.id, change.x, change.y, change.w, change.h);
+    }
+    _changes.clear();
+    for (size_t i = 0; i < _rois.size() && _tool != NULL; i++) {
+        Roi *roi = _rois[i];
+        // on demand, nothing is computed for crops nobody reads
+        if (roi->port.getOutputCount() == 0)
+            continue;
+        ImageOf<PixelRgb> &out = roi->port.prepare();
+        if (_tool->applyRoi(roi->id, in, out)) {
+            roi->port.setEnvelope(stamp);
+            // a slow fovea reader must not hold up the main output
+            roi->port.write();
+        }
+        else
+            roi->port.unprepare();
+    }
+    _mutex.post();
+}
+
+void RoiPublisher::interrupt() {
+    _mutex.wait();
+    for (size_t i = 0; i < _rois.size(); i++)
+        _rois[i]->port.interrupt();
+    _mutex.post();
+}
+
+void RoiPublisher::close() {
+    _mutex.wait();
+    for (size_t i = 0; i < _rois.size(); i++) {
+        if (_tool != NULL)
+            _tool->removeRoi(_rois[i]->id);
+        _rois[i]->port.close();
+        delete _rois[i];
+    }
+    _rois.clear();
+    _changes.clear();
+    _mutex.post();
+}
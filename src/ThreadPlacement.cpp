@@ -0,0 +1,187 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#include <iCub/ThreadPlacement.h>
+
+// std
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <set>
+
+#ifdef __linux__
+    #include <pthread.h>
+    #include <sched.h>
+    #include <unistd.h>
+    #include <sys/syscall.h>
+#endif
+
+// opencv
+#include <opencv2/opencv.hpp>
+
+// yarp
+#include <yarp/os/Bottle.h>
+#include <yarp/os/Value.h>
+
+using namespace std;
+using namespace yarp::os;
+
+#ifdef __linux__
+// from linux/mempolicy.h, avoids a libnuma dependency
+#define CAMCALIB_MPOL_LOCAL 4
+#endif
+
+namespace {
+
+#ifdef __linux__
+bool setAffinity(const vector<int> &cores) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t i = 0; i < cores.size(); i++)
+        CPU_SET(cores[i], &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// Pins every pool thread that runs a stripe. Stripes take a moment so that
+// all threads of the pool get one; the pinned threads are recorded.
+class PinBody : public cv::ParallelLoopBody
+{
+private:
+    const vector<int>   &cores;
+    cv::Mutex           &mutex;
+    set<long>           &pinned;
+
+public:
+    PinBody(const vector<int> &_cores, cv::Mutex &_mutex, set<long> &_pinned) :
+        cores(_cores), mutex(_mutex), pinned(_pinned) {
+    }
+
+    virtual void operator()(const cv::Range &) const {
+        bool ok = setAffinity(cores);
+        long tid = (long)syscall(SYS_gettid);
+        mutex.lock();
+        if (ok)
+            pinned.insert(tid);
+        mutex.unlock();
+        usleep(2000);
+    }
+};
+#endif
+
+}
+
+ThreadPlacement::ThreadPlacement() {
+    _priority = 0;
+    _numaLocal = false;
+}
+
+vector<int> ThreadPlacement::parseCores(Searchable &config, const char *key) {
+    vector<int> cores;
+    if (config.check(key)) {
+        Value &v = config.find(key);
+        if (v.isList()) {
+            Bottle *b = v.asList();
+            for (int i = 0; i < b->size(); i++)
+                cores.push_back(b->get(i).asInt());
+        }
+        else
+            cores.push_back(v.asInt());
+    }
+    return cores;
+}
+
+void ThreadPlacement::configure(Searchable &config, const char *coresKey, const char *prefix) {
+    _cores = parseCores(config, coresKey);
+    string p(prefix);
+    _priority = config.check((p + "rtpriority").c_str(), Value(0),
+                             "SCHED_FIFO priority, 0 = normal scheduling (int)").asInt();
+    _numaLocal = config.check((p + "numalocal").c_str());
+}
+
+bool ThreadPlacement::apply(const char *what) const {
+    bool ok = true;
+#ifdef __linux__
+    if (!_cores.empty() && !setAffinity(_cores)) {
+        fprintf(stdout, "====> warning: could not set cpu affinity of %s thread\n", what);
+        ok = false;
+    }
+    if (_priority > 0) {
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = _priority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err != 0) {
+            fprintf(stdout, "====> warning: could not set real-time priority of %s thread (%s)\n", what, strerror(err));
+            ok = false;
+        }
+    }
+    if (_numaLocal && syscall(SYS_set_mempolicy, CAMCALIB_MPOL_LOCAL, NULL, 0) != 0) {
+        fprintf(stdout, "====> warning: could not set local NUMA policy of %s thread (%s)\n", what, strerror(errno));
+        ok = false;
+    }
+#else
+    if (isSet()) {
+        fprintf(stdout, "====> warning: thread placement of %s thread not supported on this platform\n", what);
+        ok = false;
+    }
+#endif
+    return ok;
+}
+
+bool ThreadPlacement::placeWorkerPool(const vector<int> &cores, int threads) {
+    if (cores.empty())
+        return true;
+#ifdef __linux__
+    cpu_set_t saved;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(saved), &saved) != 0)
+        return false;
+    if (!setAffinity(cores)) {
+        fprintf(stdout, "====> warning: could not set cpu affinity of worker pool\n");
+        return false;
+    }
+    // drop a pool started earlier, then let the new one spawn while pinned;
+    // only some backends (pthreads) really respawn their threads here
+    int n = threads > 0 ? threads : (int)cores.size();
+    cv::setNumThreads(1);
+    cv::setNumThreads(n);
+    // TBB and OpenMP keep their threads, pin them from inside a parallel loop
+    cv::Mutex mutex;
+    set<long> pinned;
+    cv::parallel_for_(cv::Range(0, n * 8), PinBody(cores, mutex, pinned), n * 8);
+    pinned.erase((long)syscall(SYS_gettid));
+    pthread_setaffinity_np(pthread_self(), sizeof(saved), &saved);
+
+    // the calling thread is one of the n
+    if ((int)pinned.size() < n - 1) {
+#if CV_MAJOR_VERSION >= 3
+        const char *framework = cv::currentParallelFramework();
+#else
+        const char *framework = NULL;
+#endif
+        fprintf(stdout, "====> warning: worker pool placement reached %d of %d pool threads (%s backend), "
+                "the others keep their affinity\n", (int)pinned.size(), n - 1, framework != NULL ? framework : "unknown");
+        return false;
+    }
+    return true;
+#else
+    fprintf(stdout, "====> warning: worker pool placement not supported on this platform\n");
+    return false;
+#endif
+}
+
+bool PlacedJob::runPlaced() {
+    if (!start())
+        return false;
+    // job() returns by itself, stop() only joins
+    stop();
+    return true;
+}
+
+void PlacedJob::run() {
+    _placement.apply(_what.c_str());
+    job();
+}
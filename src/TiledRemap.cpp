@@ -0,0 +1,154 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+#include <iCub/TiledRemap.h>
+
+#include <math.h>
+#include <algorithm>
+#ifdef __linux__
+    #include <unistd.h>
+#endif
+
+// raw pixels around a footprint for demosaicing and bilinear interpolation
+static const int MARGIN = 3;
+
+// candidate tile edges, largest first
+static const int TILE_SIZES[] = { 128, 96, 64, 48, 32, 16 };
+static const int N_TILE_SIZES = sizeof(TILE_SIZES) / sizeof(TILE_SIZES[0]);
+
+class TiledRemapBody : public cv::ParallelLoopBody
+{
+private:
+    const TiledRemap    &remap;
+    const cv::Mat       &raw;
+    int                 code;
+    cv::Mat             &dst;
+
+public:
+    TiledRemapBody(const TiledRemap &_remap, const cv::Mat &_raw, int _code, cv::Mat &_dst) :
+        remap(_remap), raw(_raw), code(_code), dst(_dst) {
+    }
+
+    virtual void operator()(const cv::Range &range) const {
+        // demosaiced window, reused by the tiles of this range
+        cv::Mat rgb;
+        short *map1 = (short*)remap._map1.data;
+        unsigned short *map2 = (unsigned short*)remap._map2.data;
+        for (int i = range.start; i < range.end; i++) {
+            const TiledRemap::Tile &t = remap._tiles[i];
+            cv::Mat out = dst(t.dst);
+            if (t.src.area() == 0) {
+                out.setTo(cv::Scalar::all(0));
+                continue;
+            }
+            cv::cvtColor(raw(t.src), rgb, code);
+            cv::Mat m1(t.dst.height, t.dst.width, CV_16SC2, map1 + 2 * t.offset);
+            cv::Mat m2(t.dst.height, t.dst.width, CV_16UC1, map2 + t.offset);
+            cv::remap(rgb, out, m1, m2, cv::INTER_LINEAR);
+        }
+    }
+};
+
+TiledRemap::TiledRemap() {
+    _tileSize = 0;
+}
+
+size_t TiledRemap::cacheSize() {
+#if defined(__linux__) && defined(_SC_LEVEL2_CACHE_SIZE)
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (l2 > 0)
+        return (size_t)l2;
+#endif
+    return 256 * 1024;
+}
+
+void TiledRemap::setMaps(const cv::Mat &mapx, const cv::Mat &mapy) {
+    mapx.copyTo(_mapx);
+    mapy.copyTo(_mapy);
+    _srcSize = cv::Size();
+    _tileSize = 0;
+    _tiles.clear();
+}
+
+cv::Rect TiledRemap::footprint(const cv::Rect &tile) const {
+    double minX, maxX, minY, maxY;
+    cv::minMaxLoc(_mapx(tile), &minX, &maxX);
+    cv::minMaxLoc(_mapy(tile), &minY, &maxY);
+    // even origin keeps the Bayer phase of the window
+    int x0 = std::max(0, (int)floor(minX) - MARGIN) & ~1;
+    int y0 = std::max(0, (int)floor(minY) - MARGIN) & ~1;
+    int x1 = std::min(_srcSize.width, (int)ceil(maxX) + MARGIN + 1);
+    int y1 = std::min(_srcSize.height, (int)ceil(maxY) + MARGIN + 1);
+    // too small to demosaic only if the tile maps entirely outside the frame
+    if (x1 - x0 < 4 || y1 - y0 < 4)
+        return cv::Rect();
+    return cv::Rect(x0, y0, x1 - x0, y1 - y0);
+}
+
+void TiledRemap::build(cv::Size srcSize) {
+    _srcSize = srcSize;
+    cv::Size size = _mapx.size();
+
+    // largest tile whose working set fits in half the L2 cache: raw and
+    // demosaiced window, output pixels and fixed point maps
+    size_t budget = cacheSize() / 2;
+    _tileSize = TILE_SIZES[N_TILE_SIZES - 1];
+    for (int c = 0; c < N_TILE_SIZES; c++) {
+        int ts = TILE_SIZES[c];
+        size_t worst = 0;
+        for (int y = 0; y < size.height; y += ts) {
+            for (int x = 0; x < size.width; x += ts) {
+                cv::Rect tile(x, y, std::min(ts, size.width - x), std::min(ts, size.height - y));
+                size_t bytes = (size_t)footprint(tile).area() * 4 + (size_t)tile.area() * 9;
+                worst = std::max(worst, bytes);
+            }
+        }
+        if (worst <= budget) {
+            _tileSize = ts;
+            break;
+        }
+    }
+
+    // serpentine order, neighbouring tiles share raw rows and columns
+    _tiles.clear();
+    size_t total = 0;
+    int rows = (size.height + _tileSize - 1) / _tileSize;
+    int cols = (size.width + _tileSize - 1) / _tileSize;
+    for (int r = 0; r < rows; r++) {
+        for (int k = 0; k < cols; k++) {
+            int c = (r & 1) ? cols - 1 - k : k;
+            int x = c * _tileSize;
+            int y = r * _tileSize;
+            Tile t;
+            t.dst = cv::Rect(x, y, std::min(_tileSize, size.width - x), std::min(_tileSize, size.height - y));
+            t.src = footprint(t.dst);
+            t.offset = total;
+            total += t.dst.area();
+            _tiles.push_back(t);
+        }
+    }
+
+    // tile-contiguous fixed point maps, relative to each raw window
+    _map1.create(1, (int)total, CV_16SC2);
+    _map2.create(1, (int)total, CV_16UC1);
+    cv::Mat relx, rely;
+    for (size_t i = 0; i < _tiles.size(); i++) {
+        const Tile &t = _tiles[i];
+        cv::Mat m1(t.dst.height, t.dst.width, CV_16SC2, _map1.ptr<short>() + 2 * t.offset);
+        cv::Mat m2(t.dst.height, t.dst.width, CV_16UC1, _map2.ptr<unsigned short>() + t.offset);
+        cv::subtract(_mapx(t.dst), cv::Scalar((double)t.src.x), relx);
+        cv::subtract(_mapy(t.dst), cv::Scalar((double)t.src.y), rely);
+        cv::convertMaps(relx, rely, m1, m2, CV_16SC2);
+    }
+}
+
+void TiledRemap::apply(const cv::Mat &raw, int code, cv::Mat &dst) {
+    if (raw.size() != _srcSize)
+        build(raw.size());
+    dst.create(_mapx.size(), CV_8UC3);
+    cv::parallel_for_(cv::Range(0, (int)_tiles.size()), TiledRemapBody(*this, raw, code, dst));
+}
@@ -46,6 +46,16 @@
  * - sat x where x is < 1.0  -  will decrease saturation until a gray image is obtained
  * - sat x where x is > 1.0  -  will increase saturation 
  * 
+ * White balance, color correction and gamma are folded together with the saturation
+ * into one 3D lookup table applied after undistortion, before sharpening. It is rebuilt
+ * only when one of these parameters changes. Without a color matrix the CUDA and OpenCL
+ * backends apply the same stages on the device (a per channel table and the HSV
+ * saturation offset); with one, or on the CPU backend, the table runs on the host:
+ *
+ * - wb r g b  -  per channel white balance gains
+ * - ccm m00 m01 m02 m10 m11 m12 m20 m21 m22  -  color correction matrix (row-major)
+ * - gamma g  -  output gamma, 1.0 = linear
+ * 
  * \section parameters_sec Parameters
  * 
  * Command-line Parameters
@@ -84,6 +94,150 @@
  * p2 0.000456613
  *
  * </pre>
+ *
+ * Optional color processing parameters (command line or configuration file):
+ *
+ * <pre>
+ * whitebalance (1.0 1.0 1.0)
+ * ccm (1 0 0 0 1 0 0 0 1)
+ * gamma 1.0
+ * </pre>
+ *
+ * Pipeline variants and startup auto-tuning:
+ *
+ * - \c --backend \c auto \n
+ *   compute backend [auto|cuda|opencl|cpu]. \c auto takes CUDA if a device is present,
+ *   else OpenCL (transparent API) on a GPU, else the CPU. Without CUDA, MHT demosaicing
+ *   is replaced by edge aware interpolation.
+ *
+ * - \c --demosaic \c mht \n
+ *   demosaicing algorithm [mht|bilinear]
+ *
+ * - \c --precompose \n
+ *   fold the outwidth/outheight resize into the undistortion maps
+ *
+ * - \c --threads \c n \n
+ *   number of OpenCV worker threads for host side stages
+ *
+ * - \c --autotune \n
+ *   benchmark the variants above (all available backends unless one is given; an
+ *   explicit \c --demosaic, \c --precompose or \c --threads is kept as well)
+ *   on synthetic frames at the calibration resolution
+ *   and use the fastest; the result is stored in \c --autotunefile
+ *   (default \c camCalibTune_<hostname>.ini in the context directory under the user's
+ *   YARP home, or in the working directory without one) so later starts skip the search.
+ *   A result recorded with another OpenCV version or build, or another calibration, is
+ *   discarded and the search repeated.
+ *   \c --autotunequality \c high keeps MHT demosaicing and full resolution remap
+ *   (only CUDA implements MHT, so it is the only backend tried when present; without it
+ *   the substitute algorithm is logged and stored with the result),
+ *   \c fast allows all variants. \c --autotuneframes sets the timed frames per candidate.
+ *   Map format and CPU tile size are not tuned: CUDA needs floating point maps, the CPU
+ *   backend uses fixed point maps in tiles sized from the L2 cache.
+ *
+ * - \c --warmupframes \c 3 \n
+ *   synthetic frames run through every calibration tool before \c /in is opened, so
+ *   maps, device context, buffers and filters are built at startup instead of on the
+ *   first real frame (0 disables). Each tool warms up on a thread placed like the one
+ *   that will process its frames (\c --proccores, \c --recvcores), as does
+ *   \c --autotune. The time taken is printed.
+ *
+ * - \c --expectedsize \c WxH \n
+ *   input size used for the warm-up, by default the calibration size \c w x \c h
+ *
+ * Latency tracing:
+ *
+ * - \c --trace \n
+ *   start with tracing enabled; each frame's capture stamp, receive time, processing
+ *   stages and publish time are kept in a ring buffer of \c --tracebuffer frames (default 1024)
+ *
+ * - rpc \c trace \c on|off|reset \n
+ *   toggle or clear tracing at runtime
+ *
+ * - rpc \c trace \c dump \c file.json \n
+ *   write the ring buffer as Chrome trace / Perfetto JSON
+ *
+ * - rpc \c latency \n
+ *   capture-to-publish latency statistics and histogram (ms)
+ *
+ * Thread placement (Linux only), so that several camera modules on one host
+ * can be kept on disjoint cores:
+ *
+ * - \c --proccores \c "(2 3)" \n
+ *   cores for the port callback thread, which receives, processes and publishes
+ *
+ * - \c --rtpriority \c n \n
+ *   run the callback thread with SCHED_FIFO priority n (needs CAP_SYS_NICE)
+ *
+ * - \c --numalocal \n
+ *   allocate the callback thread's buffers on the NUMA node it runs on
+ *
+ * - \c --workercores \c "(4 5 6 7)" \n
+ *   cores for the OpenCV worker pool used by host side stages. The pthreads pool is
+ *   restarted on these cores; TBB and OpenMP pools keep their threads, which are then
+ *   pinned from within a parallel loop. Threads that do not take part in it, or that
+ *   the backend creates later, are not pinned; a warning reports how many were reached
+ *
+ * Frame level parallelism:
+ *
+ * - \c --parallelframes \c n \n
+ *   process up to n successive frames concurrently, each worker with its own
+ *   calibration tool (maps and buffers). Frames are republished in arrival order;
+ *   a frame still missing \c --reorderwait seconds (default 0.1) after a later one
+ *   finished is dropped. With n > 1 the workers use \c --proccores / \c --rtpriority /
+ *   \c --numalocal, the publishing thread \c --publishcores (\c --publishrtpriority,
+ *   \c --publishnumalocal) and the receiving callback \c --recvcores.
+ *   Outputs are sent from the worker buffers without a copy; a port whose readers
+ *   hold a frame for more than half a frame interval is switched to copies written
+ *   non-strict (its slow readers drop frames, the other ports are not held up) until
+ *   they keep up for 30 frames.
+ *
+ * Adaptive quality under overload:
+ *
+ * - \c --targetfps \c 30 \n
+ *   keep this frame rate by degrading quality (off by default). The processing time
+ *   of every \c --qualitywindow frames (default 30) is compared with the frame
+ *   interval (times \c --parallelframes); above \c --qualitydown (default 0.95) the
+ *   next step of \c --qualitysteps \c "(sharpen demosaic downscale)" is applied,
+ *   after \c --qualityupwindows windows (default 3) below \c --qualityup (default 0.6)
+ *   the last step is undone. Steps are: sharpening off, bilinear demosaicing, and
+ *   output scaled by \c --downscale (default 0.5) with the resize folded into the maps.
+ *
+ * - rpc \c quality \n
+ *   current level, its step, number of levels, adaptation on/off, last load and
+ *   number of level changes; \c latency also reports \c quality_level
+ *
+ * - rpc \c quality \c n | \c quality \c auto \n
+ *   fix the level (0 = full quality) or resume adaptation
+ *
+ * Raw input recording and replay:
+ *
+ * - \c --record \c file.raw \n
+ *   append every frame received on \c /in with its envelope to a chunked, indexed
+ *   recording (see RawRecording.h). A writer thread drains a queue of \c --recordqueue
+ *   frames (default 16), frames arriving while it is full are dropped and counted;
+ *   an index is written every \c --recordchunk frames (default 64)
+ *
+ * - rpc \c record \c file.raw | \c record \c stop | \c record \n
+ *   start, stop or query a recording at runtime
+ *
+ * - \c --replay \c file.raw \n
+ *   feed a recording instead of opening \c /in. Frames are used in place from the
+ *   memory mapped file, at the recorded timing scaled by \c --replayspeed (default 1.0,
+ *   0 = as fast as possible). With \c --replayloop the recording repeats, otherwise
+ *   the module prints the achieved rate and quits after the last frame.
+ *
+ * Full resolution crops (foveae):
+ *
+ * - rpc \c roi \c add \c name \c cx \c cy \c w \c h \n
+ *   publish a w x h crop centered at (cx, cy) of the undistorted image on
+ *   \c /camCalib/roi/name, or move and resize an existing one. Coordinates are in
+ *   input pixels whatever \c --outwidth / \c --outheight are, so \c /out can run
+ *   downscaled while the crops keep full resolution. Only the raw window a crop maps
+ *   from is demosaiced and remapped, and only while its port has a reader
+ *
+ * - rpc \c roi \c del \c name | \c roi \c list \n
+ *   remove a crop and its port, list the crops as (name cx cy w h)
  * \section portsc_sec Ports Created
  *
  * Input port 
@@ -96,6 +250,23 @@
  * - \c /camCalib/out \n
  *   Calibrated output image (rgb)
  *
+ * - \c /camCalib/out/mono, \c /camCalib/out/nv12, \c /camCalib/out/i420 \n
+ *   Calibrated output in reduced formats, selected with \c --outformat \c "(mono nv12)"
+ *   (default \c rgb, any combination of rgb, mono, nv12 and i420; \c /out only exists
+ *   when rgb is listed). Mono is full range luma, converted on the GPU unless color
+ *   processing falls back to the host (a color matrix, see above). nv12 and i420 are
+ *   BT.601 video range 4:2:0 sent as mono images of height * 3 / 2 packed rows (Y plane,
+ *   then chroma) and need an even output size. All formats come from one processing pass and carry the same envelope stamp.
+ *
+ * - \c /camCalib/out/compressed \n
+ *   Only with \c --compressed: the calibrated image as JPEG slices encoded in parallel
+ *   (see JpegSliceEncoder), same envelope stamp as \c /out (needs rgb in \c --outformat). \c --jpegquality (default 85,
+ *   rpc \c jpegquality) and \c --jpegslices (default one per worker thread) control the encoder.
+ *
+ * - \c /camCalib/roi/<name> \n
+ *   Full resolution undistorted crops added with rpc \c roi \c add (rgb), same envelope
+ *   stamp as the frame they were cut from
+ *
  * Rpc port
  *
  * - \c /camCalib/conf \n
@@ -0,0 +1,373 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0.
+ *
+ */
+
+/**
+ * Load and soak test for the camCalib module.
+ *
+ * Runs one or more camCalib module instances in-process on a local YARP
+ * name space (no external name server needed), feeds each from a synthetic
+ * camera publisher and reads the outputs with configurably slow consumers.
+ * Reports sustained fps, drop rates, end-to-end latency distribution and
+ * resident memory growth.
+ *
+ * <tt>camCalibSoak --streams 2 --width 1280 --height 960 --fps 30 --duration 600
+ *  --consumerdelay "(0.0 0.05)" [module options, e.g. --parallelframes 4]</tt>
+ *
+ * - \c --streams        number of camera/module pairs (default 1)
+ * - \c --width, \c --height, \c --fps  synthetic camera format (default 640x480 at 30, fractional rates allowed)
+ * - \c --duration       run time in seconds (default 60)
+ * - \c --report         seconds between reports (default 5)
+ * - \c --consumerdelay  one consumer per entry, each sleeping that long per frame (default (0.0))
+ *
+ * All other options are passed on to the module instances.
+ */
+
+// std
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#ifdef __linux__
+    #include <unistd.h>
+#endif
+
+// yarp
+#include <yarp/os/all.h>
+#include <yarp/sig/all.h>
+
+// opencv
+#include <opencv2/opencv.hpp>
+
+// iCub
+#include <iCub/CalibToolFactory.h>
+#include <iCub/PinholeCalibTool.h>
+#include <iCub/CamCalibModule.h>
+
+using namespace std;
+using namespace yarp::os;
+using namespace yarp::sig;
+
+/**
+ * Synthetic camera with raw Bayer-like content and counted stamps, paced on
+ * absolute deadlines so fractional periods keep the requested rate
+ */
+class SyntheticCamera : public Thread
+{
+private:
+    BufferedPort<ImageOf<PixelRgb> > port;
+    vector<cv::Mat> frames;
+    int width, height;
+    double period;
+    unsigned int count;
+
+    void send() {
+        ImageOf<PixelRgb> &img = port.prepare();
+        img.resize(width, height);
+        cv::Mat dst(cv::cvarrToMat((IplImage*)img.getIplImage()));
+        frames[count % frames.size()].copyTo(dst);
+        Stamp stamp(count, Time::now());
+        port.setEnvelope(stamp);
+        port.write();
+        count++;
+    }
+
+public:
+    SyntheticCamera(double fps, int _width, int _height) {
+        period = 1.0 / fps;
+        width = _width;
+        height = _height;
+        count = 0;
+        // a few noise frames, cycled, so generation does not limit the rate
+        for (int i = 0; i < 4; i++) {
+            cv::Mat m(height, width, CV_8UC3);
+            cv::randu(m, cv::Scalar::all(0), cv::Scalar::all(255));
+            frames.push_back(m);
+        }
+    }
+
+    bool open(const string &name) { return port.open(name.c_str()); }
+    void close() { port.close(); }
+    unsigned int getCount() { return count; }
+
+    virtual void run() {
+        double next = Time::now();
+        while (!isStopping()) {
+            send();
+            next += period;
+            double wait = next - Time::now();
+            if (wait > 0)
+                Time::delay(wait);
+            else
+                next = Time::now();     // fell behind, do not burst to catch up
+        }
+    }
+};
+
+/** Output reader recording latency and stamp gaps */
+class SlowConsumer : public BufferedPort<ImageOf<PixelRgb> >
+{
+private:
+    double delay;
+    Semaphore mutex;
+    vector<double> latencies;
+    unsigned int received;
+    unsigned int dropped;
+    int lastCount;
+
+public:
+    SlowConsumer(double _delay) : mutex(1) {
+        delay = _delay;
+        received = 0;
+        dropped = 0;
+        lastCount = -1;
+        useCallback();
+    }
+
+    virtual void onRead(ImageOf<PixelRgb> &img) {
+        Stamp stamp;
+        getEnvelope(stamp);
+        double latency = Time::now() - stamp.getTime();
+        mutex.wait();
+        latencies.push_back(latency);
+        received++;
+        if (lastCount >= 0 && stamp.getCount() > lastCount + 1)
+            dropped += stamp.getCount() - lastCount - 1;
+        lastCount = stamp.getCount();
+        mutex.post();
+        if (delay > 0)
+            Time::delay(delay);
+    }
+
+    /** Returns and clears the counters of the last interval */
+    void take(vector<double> &lat, unsigned int &recv, unsigned int &drop) {
+        mutex.wait();
+        lat.swap(latencies);
+        latencies.clear();
+        recv = received;
+        drop = dropped;
+        received = 0;
+        dropped = 0;
+        mutex.post();
+    }
+};
+
+static double residentMB() {
+#ifdef __linux__
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f == NULL)
+        return -1.0;
+    long pages = 0, resident = 0;
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+        resident = -1;
+    fclose(f);
+    return resident < 0 ? -1.0 : resident * (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+#else
+    return -1.0;
+#endif
+}
+
+static double percentile(vector<double> &v, double p) {
+    if (v.empty())
+        return 0.0;
+    size_t i = (size_t)(p * (v.size() - 1));
+    return v[i];
+}
+
+/** Whole-run latency distribution in fixed 0.1 ms bins, so it does not grow with the run */
+class LatencyHistogram
+{
+private:
+    static const int BINS = 10000;      ///< up to 1 s, later samples go to the last bin
+    vector<unsigned int> _bins;
+    unsigned int _count;
+    double _max;
+
+public:
+    LatencyHistogram() : _bins(BINS, 0), _count(0), _max(0.0) {}
+
+    void add(const vector<double> &lat) {
+        for (size_t i = 0; i < lat.size(); i++) {
+            int b = (int)(lat[i] * 10000.0);
+            _bins[b < 0 ? 0 : (b >= BINS ? BINS - 1 : b)]++;
+            _max = std::max(_max, lat[i]);
+        }
+        _count += (unsigned int)lat.size();
+    }
+
+    /** Upper edge of the bin holding the p-quantile, in seconds */
+    double percentile(double p) const {
+        if (_count == 0)
+            return 0.0;
+        unsigned int rank = (unsigned int)(p * (_count - 1));
+        unsigned int seen = 0;
+        for (int b = 0; b < BINS; b++) {
+            seen += _bins[b];
+            if (seen > rank)
+                return std::min((b + 1) / 10000.0, _max);
+        }
+        return _max;
+    }
+
+    double max() const { return _max; }
+};
+
+static bool writeCalibration(const string &file, int width, int height) {
+    FILE *f = fopen(file.c_str(), "w");
+    if (f == NULL)
+        return false;
+    fprintf(f, "[CAMERA_CALIBRATION]\n");
+    fprintf(f, "projection pinhole\ndrawCenterCross 0\n");
+    fprintf(f, "w %d\nh %d\n", width, height);
+    fprintf(f, "fx %g\nfy %g\ncx %g\ncy %g\n", 0.7 * width, 0.7 * width, 0.5 * width, 0.5 * height);
+    fprintf(f, "k1 -0.397161\nk2 0.180303\np1 4.08465e-005\np2 0.000456613\n");
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+
+    CalibToolFactories& pool = CalibToolFactories::getPool();
+    pool.add(new CalibToolFactoryOf<PinholeCalibTool>("pinhole"));
+
+    // in-process name space stands in for a yarp server
+    Network::setLocalMode(true);
+    Network yarp;
+
+    ResourceFinder opts;
+    opts.configure(argc, argv);
+    int streams  = opts.check("streams", Value(1)).asInt();
+    int width    = opts.check("width", Value(640)).asInt();
+    int height   = opts.check("height", Value(480)).asInt();
+    double fps   = opts.check("fps", Value(30.0)).asDouble();
+    double duration = opts.check("duration", Value(60.0)).asDouble();
+    double report   = opts.check("report", Value(5.0)).asDouble();
+    vector<double> delays;
+    if (opts.check("consumerdelay")) {
+        Value &v = opts.find("consumerdelay");
+        if (v.isList()) {
+            for (int i = 0; i < v.asList()->size(); i++)
+                delays.push_back(v.asList()->get(i).asDouble());
+        }
+        else
+            delays.push_back(v.asDouble());
+    }
+    if (delays.empty())
+        delays.push_back(0.0);
+    if (fps <= 0 || width <= 0 || height <= 0 || streams <= 0) {
+        fprintf(stdout, "--fps, --width, --height and --streams must be positive\n");
+        return 1;
+    }
+
+    string calibFile = "camCalibSoak.ini";
+    if (!writeCalibration(calibFile, width, height)) {
+        fprintf(stdout, "could not write %s\n", calibFile.c_str());
+        return 1;
+    }
+
+    vector<CamCalibModule*> modules;
+    vector<SyntheticCamera*> cameras;
+    vector<SlowConsumer*> consumers;
+    for (int s = 0; s < streams; s++) {
+        char name[64];
+        sprintf(name, "/camCalibSoak/%d", s);
+
+        // the module sees the harness options plus its own name and calibration
+        vector<string> args(argv, argv + argc);
+        args.push_back("--from");
+        args.push_back(calibFile);
+        args.push_back("--group");
+        args.push_back("CAMERA_CALIBRATION");
+        args.push_back("--name");
+        args.push_back(name);
+        vector<char*> margv;
+        for (size_t i = 0; i < args.size(); i++)
+            margv.push_back(const_cast<char*>(args[i].c_str()));
+        ResourceFinder rf;
+        rf.configure((int)margv.size(), &margv[0]);
+
+        CamCalibModule *module = new CamCalibModule();
+        if (!module->configure(rf)) {
+            fprintf(stdout, "module %s failed to configure\n", name);
+            return 1;
+        }
+        modules.push_back(module);
+
+        SyntheticCamera *camera = new SyntheticCamera(fps, width, height);
+        camera->open(string(name) + "/camera");
+        Network::connect((string(name) + "/camera").c_str(), (string(name) + "/in").c_str());
+        cameras.push_back(camera);
+
+        for (size_t c = 0; c < delays.size(); c++) {
+            char cname[80];
+            sprintf(cname, "%s/consumer%d", name, (int)c);
+            SlowConsumer *consumer = new SlowConsumer(delays[c]);
+            consumer->open(cname);
+            Network::connect((string(name) + "/out").c_str(), cname);
+            consumers.push_back(consumer);
+        }
+    }
+
+    vector<unsigned int> lastSent(cameras.size(), 0);
+    LatencyHistogram all;
+
+    double rss0 = residentMB();
+    double tStart = Time::now();
+    for (size_t i = 0; i < cameras.size(); i++)
+        cameras[i]->start();
+
+    unsigned int totalRecv = 0, totalDrop = 0;
+    while (Time::now() - tStart < duration) {
+        Time::delay(report);
+        double elapsed = Time::now() - tStart;
+        fprintf(stdout, "--- %.0f s, rss %.1f MB (%+.1f MB)\n", elapsed, residentMB(), residentMB() - rss0);
+        for (size_t s = 0; s < cameras.size(); s++) {
+            unsigned int sent = cameras[s]->getCount();
+            fprintf(stdout, "stream %d: sent %.1f fps\n", (int)s, (sent - lastSent[s]) / report);
+            lastSent[s] = sent;
+            for (size_t c = 0; c < delays.size(); c++) {
+                vector<double> lat;
+                unsigned int recv, drop;
+                consumers[s * delays.size() + c]->take(lat, recv, drop);
+                sort(lat.begin(), lat.end());
+                fprintf(stdout, "  consumer %d (delay %g s): %.1f fps, dropped %.1f%%, latency ms p50 %.1f p95 %.1f p99 %.1f max %.1f\n",
+                        (int)c, delays[c], recv / report,
+                        recv + drop > 0 ? 100.0 * drop / (recv + drop) : 0.0,
+                        percentile(lat, 0.5) * 1000, percentile(lat, 0.95) * 1000,
+                        percentile(lat, 0.99) * 1000, lat.empty() ? 0.0 : lat.back() * 1000);
+                all.add(lat);
+                totalRecv += recv;
+                totalDrop += drop;
+            }
+        }
+        fflush(stdout);
+    }
+
+    for (size_t i = 0; i < cameras.size(); i++)
+        cameras[i]->stop();
+
+    double elapsed = Time::now() - tStart;
+    fprintf(stdout, "=== summary over %.0f s: %.1f fps per consumer, dropped %.2f%%, latency ms p50 %.1f p99 %.1f max %.1f, rss growth %+.1f MB\n",
+            elapsed, totalRecv / elapsed / consumers.size(),
+            totalRecv + totalDrop > 0 ? 100.0 * totalDrop / (totalRecv + totalDrop) : 0.0,
+            all.percentile(0.5) * 1000, all.percentile(0.99) * 1000,
+            all.max() * 1000, residentMB() - rss0);
+
+    for (size_t i = 0; i < modules.size(); i++) {
+        modules[i]->interruptModule();
+        modules[i]->close();
+        delete modules[i];
+    }
+    for (size_t i = 0; i < cameras.size(); i++) {
+        cameras[i]->close();
+        delete cameras[i];
+    }
+    for (size_t i = 0; i < consumers.size(); i++) {
+        consumers[i]->close();
+        delete consumers[i];
+    }
+    return 0;
+}